@@ -1,13 +1,19 @@
 #include "Json.h"
+#include "JsonSAXParser.h"
+#include "JsonStatsHooks.h"
 #include <charconv>
-#include <list>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <deque>
 
-constexpr size_t DOUBLE_MAX = 15;  //0..14 + point(1)
-constexpr size_t NEGATIVE_DOUBLE_MAX = DOUBLE_MAX + 1;
-constexpr size_t INTEGER_MAX = 18; //0..18
-constexpr size_t NEGATIVE_INTEGER_MAX = INTEGER_MAX + 1;
+using namespace JsonSAXDetail;
 
-static inline bool isControlCode(unsigned char value){ return (value <= 8 || (value >= 14 && value <= 31) || value == 127); }
+constexpr size_t DOUBLE_TEXT = 24; //std::to_chars buffer, the longest shortest double: -2.2250738585072014e-308
 
 //----------------------------------------------------------------
 
@@ -24,6 +30,13 @@ unsigned char JsonStringViewBufferReader::value(){ return (static_cast<std::size
 
 std::size_t JsonStringViewBufferReader::offset(){ return static_cast<std::size_t>(pos); }
 
+bool JsonStringViewBufferReader::copy(std::size_t first, std::size_t last, std::string & data)
+{
+    if(last < first || last >= _json.size()) return false;
+    data.assign(_json.substr(first, last - first + 1));
+    return true;
+}
+
 //---------------
 
 JsonFileBufferReader::JsonFileBufferReader(){}
@@ -33,7 +46,7 @@ bool JsonFileBufferReader::open(const std::string & fileName)
     c = 0;
     pos = 0;
     if(stream.is_open()) stream.close();
-    stream.open(fileName);
+    stream.open(fileName, std::ios::in | std::ios::binary);
     is_open = stream.is_open();
     return is_open;
 }
@@ -55,633 +68,806 @@ unsigned char JsonFileBufferReader::value(){ return c; }
 
 std::size_t JsonFileBufferReader::offset(){ return pos; }
 
+bool JsonFileBufferReader::copy(std::size_t first, std::size_t last, std::string & data)
+{
+    //offset of the first byte is 1
+    if(first == 0 || last < first || last > pos) return false;
+
+    const std::streampos current = stream.tellg();
+    data.resize(last - first + 1);
+    stream.seekg(static_cast<std::streamoff>(first - 1));
+    const bool ret = static_cast<bool>(stream.read(data.data(), static_cast<std::streamsize>(data.size())));
+    stream.clear();
+    stream.seekg(current);
+    return ret;
+}
+
+//----------------------------------------------------------------
+
+void JsonSAXParser::stopParse(){ stop = true; }
+
+void JsonSAXParser::setLimits(const Limits & limits)
+{
+    _limits = limits;
+    maxDepth = (limits.depth > 0) ? limits.depth : NoLimit;
+    maxTokens = (limits.tokens > 0) ? limits.tokens : NoLimit;
+    maxString = (limits.string > 0) ? limits.string : NoLimit;
+    maxBytes = (limits.bytes > 0) ? limits.bytes : NoLimit;
+}
+
+JsonSAXParser::Limits JsonSAXParser::limits() const { return _limits; }
+
+JsonSAXParser::JsonSAXParser(){}
+
+std::string JsonSAXParser::error() const { return std::move(_error); }
+
+const JsonStats & JsonSAXParser::stats() const { return _stats; }
+void JsonSAXParser::resetStats(){ _stats = JsonStats(); }
+
+//---------------
+
+JsonSAXReader::JsonSAXReader(){}
+JsonSAXReader::~JsonSAXReader(){}
+
+bool JsonSAXReader::parse(JsonBufferReader & buffer, Operation operation, JsonFormat format){ return JsonSAXParser::parse(*this, buffer, operation, format); }
+
 //----------------------------------------------------------------
 
-static const char * const ControlCharacterDetectionMsg = "Control character detection, offset: ",
-                  * const InvalidNumberMsg = "Invalid number, offset: ",
-                  * const ALotPointMsg = "A lot or an incorrect numeric point, offset: ",
-                  * const NumberRangeMsg = "Number out of range, offset: ",
-                  * const NumberOutOfArrayMsg = "Number out of array limit, offset: ",
-                  * const StringOutOfArrayMsg = "String out of array limit, offset: ",
-                  * const ValueOutOfArrayMsg = "Value out of array limit, offset: ",
-                  * const InvalidValueMsg = "Invalid value, offset: ",
-                  * const InvalidEntryCharacterMsg = "Invalid entry character '",
-                  * const InvalidObjectKeyMsg = "Invalid starting symbol of the object key or the end of an object '",
-                  * const InvalidObjectKeyValueMsg = "Invalid object key-value separator character '",
-                  * const InvalidSeparatorObjectMsg = "Invalid pair separator or end of object symbol, offset: ",
-                  * const InvalidSeparatorArrayMsg = "Invalid value separator or end of array symbol, offset: ",
-                  * const UnexpectedEndMsg = "Unexpected end of json stream",
-                  * const InvalidSpecialCharMsg = "Invalid special character in string '\\";
+static thread_local std::pmr::memory_resource * memory = nullptr; //JsonValue::MemoryScope
+
+JsonValue::MemoryScope::MemoryScope(std::pmr::memory_resource * resource) : previous(memory){ memory = resource; }
+JsonValue::MemoryScope::~MemoryScope(){ memory = previous; }
+std::pmr::memory_resource * JsonValue::memoryResource(){ return memory; }
 
-static std::string makeError(const char * msg, JsonBufferReader & buffer)
+//the global allocator is used directly, without the virtual calls of a memory resource
+template<typename T>
+static std::shared_ptr<T> makeNode()
 {
-    return  msg + std::to_string(buffer.offset());
+   if(memory == nullptr) return std::make_shared<T>(std::pmr::get_default_resource());
+   return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(memory), memory);
 }
 
-static std::string makeError(const char * msg, unsigned char ch, JsonBufferReader & buffer)
+std::shared_ptr<JsonValue::Value> JsonValue::makeShell()
 {
-    return std::string(msg) + static_cast<const char>(ch) + "', offset: " + std::to_string(buffer.offset());
+   if(memory == nullptr) return std::make_shared<Value>();
+   return std::allocate_shared<Value>(std::pmr::polymorphic_allocator<Value>(memory));
 }
 
-//----------------------------------------------------------------
+//----------------------
 
-enum class JsonReaderType : unsigned char
+struct JsonValue::Object::Node
 {
-     Object = 0,
-     ObjectKey,
-     ObjectValue,
-     ObjectNextPair,
-     ObjectNextKey,
+   Map map;
+   Slot slot;
 
-     Array,
-     ArrayNext,
-     ArrayNextValue
+   explicit Node(std::pmr::memory_resource * resource) : map(resource){}
 };
 
-static bool readyString(std::string & temp, JsonBufferReader & buffer, std::string & error)
+JsonValue::Object::Object()
 {
-    bool exit = false, special = false;
-
-    while(buffer.next())
-    {
-          const unsigned char ch = buffer.value();
+   auto node = makeNode<Node>();
+   map = std::shared_ptr<Map>(node, &node->map);
+   slot = std::shared_ptr<Slot>(node, &node->slot);
+}
 
-          if(isControlCode(ch))
-          {
-             error =  makeError(ControlCharacterDetectionMsg, buffer);
-             return false;
-          }
+JsonValue::Object::Object(const Map & map) : Object(){ *this->map = map; }
+JsonValue::Object::Object(Map && map) : Object(){ *this->map = std::move(map); }
+JsonValue::Object JsonValue::Object::copy() const
+{
+   Object ret;
+   *ret.map = *map;
+   return ret;
+}
 
-          if(!special && ch == '"')
-          {
-             exit = true;
-             break;
-          }
+std::size_t JsonValue::Object::count() const { return map->size(); }
+bool JsonValue::Object::contains(const std::string & key) const { return map->contains(key); }
+JsonValue JsonValue::Object::value(const std::string & key) const { return (map->contains(key)) ? map->operator[](key) : JsonValue(); }
+void JsonValue::Object::insert(std::string key, JsonValue value) const { invalidate(); map->try_emplace(std::move(key), std::move(value)); }
+void JsonValue::Object::remove(const std::string & key){ invalidate(); map->erase(key); }
+void JsonValue::Object::clear(){ invalidate(); map->clear(); }
+JsonValue & JsonValue::Object::operator [](const std::string & key) const { invalidate(); return map->operator[](key); }
+const JsonValue::Object::Map & JsonValue::Object::getMap() const { return *map; }
+JsonValue::Object::Map & JsonValue::Object::getMap(){ invalidate(); return *map; }
 
-          if(!special && ch == '\\')
-          {
-             special = true;
-             continue;
-          }
+JsonValue::Object::operator const Map &() const { return *map; }
+JsonValue::Object::operator Map &(){ invalidate(); return *map; }
 
-          if(special)
-          {
-             switch (ch)
-             {
-                case '"':
-                case '\\':
-                case '/': temp.push_back(ch);
-                break;
-                case 'b': temp.push_back('\b');
-                break;
-                case 'f': temp.push_back('\f');
-                break;
-                case 'n': temp.push_back('\n');
-                break;
-                case 'r': temp.push_back('\r');
-                break;
-                case 't': temp.push_back('\t');
-                break;
-                case 'u':
-                {
-                     temp.push_back('\\');
-                     temp.push_back(ch);
-                }
-                break;
-                default:
-                {
-                     error =  makeError(InvalidSpecialCharMsg, ch, buffer);
-                     return false;
-                }
-             }
+void JsonValue::Object::setMap(const Map & map){ invalidate(); *this->map = map; }
+void JsonValue::Object::setMap(Map && map){ invalidate(); *this->map = std::move(map); }
+JsonValue::Object & JsonValue::Object::operator = (const Map & map)
+{
+   invalidate();
+   *this->map = map;
+   return *this;
+}
+JsonValue::Object & JsonValue::Object::operator = (Map && map)
+{
+   invalidate();
+   *this->map = std::move(map);
+   return *this;
+}
 
-             special = false;
-             continue;
-          }
+//----------------------
 
-          temp.push_back(ch);
-    }
+struct JsonValue::Array::Node
+{
+   Vector array;
+   Slot slot;
 
-    if(!exit)
-    {
-       error =  makeError(StringOutOfArrayMsg, buffer);
-       return false;
-    }
+   explicit Node(std::pmr::memory_resource * resource) : array(resource){}
+};
 
-    return true;
+JsonValue::Array::Array()
+{
+   auto node = makeNode<Node>();
+   array = std::shared_ptr<Vector>(node, &node->array);
+   slot = std::shared_ptr<Slot>(node, &node->slot);
 }
 
-static inline bool readyObjectKey(JsonSAXReader * self, JsonBufferReader & buffer, std::string & error)
+JsonValue::Array::Array(const Vector & array) : Array(){ *this->array = array; }
+JsonValue::Array::Array(Vector && array) : Array(){ *this->array = std::move(array); }
+JsonValue::Array JsonValue::Array::copy() const
 {
-    std::string temp;
-    if(!readyString(temp, buffer, error)) return false;
-    self->ObjectKey(temp);
-    return true;
+   Array ret;
+   *ret.array = *array;
+   if(slot->indexes) ret.slot->indexes = std::make_unique<std::vector<Index>>(*slot->indexes);
+   return ret;
 }
 
-static inline bool readyStringValue(JsonSAXReader * self, JsonBufferReader & buffer, std::string & error)
+std::size_t JsonValue::Array::count() const { return array->size(); }
+JsonValue & JsonValue::Array::at(std::size_t index) const { invalidate(); return array->at(index); }
+void JsonValue::Array::append(JsonValue value)
 {
-    std::string temp;
-    if(!readyString(temp, buffer, error)) return false;
-    self->Value(temp);
-    return true;
+   invalidate();
+   array->push_back(std::move(value));
+   if(slot->indexes) indexLast();
 }
 
-static inline bool readyNumber(const unsigned char digit, std::stack<JsonReaderType> & depth, JsonSAXReader * self, JsonBufferReader & buffer, std::string & error)
-{
-    enum End
-    {
-         None = 0,
-         Object,
-         Array,
-         Separator
-    };
+void JsonValue::Array::clear(){ reshape(); array->clear(); }
+JsonValue & JsonValue::Array::operator[](std::size_t index) const { invalidate(); return array->at(index); }
+const JsonValue::Array::Vector & JsonValue::Array::getVector() const { return *array; }
+JsonValue::Array::Vector & JsonValue::Array::getVector(){ reshape(); return *array; }
 
-    End end = None;
-    int points = 0;
-    bool neg = (digit == '-'), exit = false;
+JsonValue::Array::operator const Vector &() const{ return *array; }
+JsonValue::Array::operator Vector &() { reshape(); return *array; }
 
-    std::string temp;
-    temp.push_back(digit);
+void JsonValue::Array::setVector(const Vector & vector){ reshape(); *array = vector; }
+void JsonValue::Array::setVector(Vector && vector){ reshape(); *array = std::move(vector); }
+JsonValue::Array & JsonValue::Array::operator = (const Vector & vector)
+{
+   reshape();
+   *array = vector;
+   return *this;
+}
+JsonValue::Array & JsonValue::Array::operator = (Vector && vector)
+{
+   reshape();
+   *array = std::move(vector);
+   return *this;
+}
 
-    unsigned char ch;
-    for(std::size_t i = 0; buffer.next(); i++)
-    {
-        ch = buffer.value();
+void JsonValue::Array::reshape()
+{
+   invalidate();
+   if(slot->indexes){ for(Index & index : *slot->indexes) index.stale = true; }
+}
 
-        if(isControlCode(ch))
-        {
-           error =  makeError(ControlCharacterDetectionMsg, buffer);
-           return false;
-        }
+JsonValue::Index & JsonValue::Array::addIndex(const Path & path)
+{
+   if(!slot->indexes) slot->indexes = std::make_unique<std::vector<Index>>();
+   std::vector<Index> & indexes = *slot->indexes;
 
-        //-----------------------------------------------------------------------
+   auto it = std::find_if(indexes.begin(), indexes.end(), [&path](const Index & index){ return index.path == path; });
+   if(it == indexes.end()) it = indexes.insert(indexes.end(), Index{path, {}, true});
+   return *it;
+}
 
-        if(std::isspace(ch))
-        {
-           exit = true;
-           break;
-        }
+//lookups on a shared array run on several threads, they never build an index
+const JsonValue::Index * JsonValue::Array::findIndex(const Path & path) const
+{
+   if(!slot->indexes) return nullptr;
+   const std::vector<Index> & indexes = *slot->indexes;
 
-        if(ch == ',')
-        {
-           if(depth.top() < JsonReaderType::Array) depth.top() = JsonReaderType::ObjectNextKey;
-           else depth.top() = JsonReaderType::ArrayNextValue;
+   auto it = std::find_if(indexes.begin(), indexes.end(), [&path](const Index & index){ return index.path == path; });
+   return (it == indexes.end() || it->stale) ? nullptr : &*it;
+}
 
-           end = Separator;
-           exit = true;
-           break;
-        }
+void JsonValue::Array::indexLast()
+{
+   IndexKey key;
+   for(Index & index : *slot->indexes)
+   {
+       if(!index.stale && indexKey(array->back(), index.path, key)) index.positions.emplace(std::move(key), array->size() - 1);
+   }
+}
 
-        if(ch == '}')
-        {
-           if(depth.top() > JsonReaderType::ObjectNextKey)
-           {
-              error =  makeError(InvalidSeparatorArrayMsg, buffer);
-              return false;
-           }
+void JsonValue::Array::index(const Path & path)
+{
+   Index & index = addIndex(path);
+   index.positions.clear();
+   index.positions.reserve(array->size());
 
-           depth.pop();
-           end = Object;
-           exit = true;
-           break;
-        }
+   IndexKey key;
+   for(std::size_t i = 0; i < array->size(); i++)
+   {
+       if(indexKey((*array)[i], path, key)) index.positions.emplace(std::move(key), i);
+   }
 
-        if(ch == ']')
-        {
-           if(depth.top() < JsonReaderType::Array)
-           {
-              error =  makeError(InvalidSeparatorObjectMsg, buffer);
-              return false;
-           }
+   index.stale = false;
+}
 
-           depth.pop();
-           end = Array;
-           exit = true;
-           break;
-        }
+void JsonValue::Array::dropIndex(const Path & path)
+{
+   if(slot->indexes) std::erase_if(*slot->indexes, [&path](const Index & index){ return index.path == path; });
+}
 
-        //-----------------------------------------------------------------------
+bool JsonValue::Array::hasIndex(const Path & path) const
+{
+   return slot->indexes && std::any_of(slot->indexes->begin(), slot->indexes->end(), [&path](const Index & index){ return index.path == path; });
+}
 
-        if(neg)
-        {
-           if((points > 0 && i == NEGATIVE_DOUBLE_MAX) || (points == 0 && i == NEGATIVE_INTEGER_MAX))
-           {
-              exit = true;
-              break;
-           }
-        }
-        else if((points > 0 && i == DOUBLE_MAX) || (points == 0 && i == INTEGER_MAX))
-        {
-           exit = true;
-           break;
-        }
+JsonValue * JsonValue::Array::lookup(const Path & path, const JsonValue & key) const
+{
+   IndexKey value;
+   if(!indexKey(key, {}, value)) return nullptr;
 
-        //-----------------------------------------------------------------------
+   const Index * index = findIndex(path);
+   IndexKey item;
 
-        if(ch == '.')
-        {
-           if(points == 1 || (neg && i == 0))
-           {
-              error =  makeError(ALotPointMsg, buffer);
-              return false;
-           }
+   if(index == nullptr)
+   {
+      for(JsonValue & candidate : *array)
+      {
+          if(indexKey(candidate, path, item) && item == value) return &candidate;
+      }
+      return nullptr;
+   }
 
-           temp.push_back(ch);
-           points++;
-           continue;
-        }
+   auto [first, last] = index->positions.equal_range(value);
+   if(first == last) return nullptr;
 
-        if(std::isdigit(ch) == 0)
-        {
-           error =  makeError(InvalidNumberMsg, buffer);
-           return false;
-        }
+   std::size_t pos = first->second;
+   for(++first; first != last; ++first) pos = std::min(pos, first->second);
+   return &(*array)[pos];
+}
 
-        temp.push_back(ch);
-    }
+std::vector<std::size_t> JsonValue::Array::lookupAll(const Path & path, const JsonValue & key) const
+{
+   std::vector<std::size_t> ret;
+   IndexKey value;
+   if(!indexKey(key, {}, value)) return ret;
 
-    if(!exit)
-    {
-       error =  makeError(NumberOutOfArrayMsg, buffer);
-       return false;
-    }
+   const Index * index = findIndex(path);
+   IndexKey item;
 
-    if(end == None && std::isspace(ch) == 0)
-    {
-       error =  makeError(InvalidValueMsg, buffer);
-       return false;
-    }
+   if(index == nullptr)
+   {
+      for(std::size_t i = 0; i < array->size(); i++)
+      {
+          if(indexKey((*array)[i], path, item) && item == value) ret.push_back(i);
+      }
+      return ret;
+   }
 
-    if(temp.back() == '.')
-    {
-       error =  makeError(ALotPointMsg, buffer);
-       return false;
-    }
+   auto [first, last] = index->positions.equal_range(value);
+   for(; first != last; ++first) ret.push_back(first->second);
+   std::sort(ret.begin(), ret.end());
+   return ret;
+}
 
-    if(points == 1)
-    {
-       double value = std::stod(temp, nullptr);
+//----------------------
 
-       if(errno == ERANGE)
-       {
-          error =  makeError(NumberRangeMsg, buffer);
-          return false;
-       }
+JsonValue::JsonValue(){}
+JsonValue::JsonValue(const Object & object){ *value = object; }
+JsonValue::JsonValue(const Array & array){ *value = array; }
+JsonValue::JsonValue(char c){ setString(c); }
+JsonValue::JsonValue(const char * string){ setString(string); }
+JsonValue::JsonValue(std::string_view string){ setString(string); }
+JsonValue::JsonValue(const std::string & string){ *value = string; }
+JsonValue::JsonValue(std::string && string){ *value = std::move(string); }
+JsonValue::JsonValue(float val){ setDouble(val); }
+JsonValue::JsonValue(double val){ *value = val; }
+JsonValue::JsonValue(unsigned char val){ setLongLong(val); }
+JsonValue::JsonValue(short val){ setLongLong(val); }
+JsonValue::JsonValue(unsigned short val){ setLongLong(val); }
+JsonValue::JsonValue(int val){ setLongLong(val); }
+JsonValue::JsonValue(unsigned int val){ setLongLong(val); }
+JsonValue::JsonValue(long long val){ *value = val; }
+JsonValue::JsonValue(bool val){ *value = val; }
+JsonValue::JsonValue(std::nullptr_t){ *value = std::nullptr_t(); }
+JsonValue::JsonValue(const Raw & raw){ *value = raw; }
+JsonValue::JsonValue(Raw && raw){ *value = std::move(raw); }
 
-       self->Value(value);
-    }
-    else if(points == 0)
-    {
-       long long value;
-       std::string_view view(temp.begin(), temp.end());
-       auto [ptr, ec] { std::from_chars(view.begin(), view.end(), value) };
+JsonValue JsonValue::copy() const
+{
+   JsonValue ret;
+   *ret.value = *value;
+   return ret;
+}
 
-       if(ec != std::errc())
-       {
-          error =  makeError(NumberRangeMsg, buffer);
-          return false;
-       }
+JsonValue JsonValue::clone() const
+{
+   JsonValue ret;
+   *ret.value = *value;
 
-       self->Value(value);
-    }
+   std::unordered_map<const void *, Value> copies; //source container -> its copy
+   std::vector<Value *> pending = {ret.value.get()};
 
-    if(end == Object) self->ObjectEnd();
-    else if(end == Array) self->ArrayEnd();
+   while(!pending.empty())
+   {
+       Value * node = pending.back();
+       pending.pop_back();
 
-    return true;
-}
+       if(Object * object = std::get_if<Object>(node))
+       {
+          auto [copy, inserted] = copies.try_emplace(object->map.get(), Object());
+          const Object source = *object;
+          *node = copy->second;
+          if(!inserted) continue;
 
-static inline bool readyValue(std::string_view value, JsonBufferReader & buffer, std::string & error)
-{
-    std::size_t i = 0;
-    while(i < value.size() && buffer.next())
-    {
-          unsigned char ch = buffer.value();
+          Object & target = std::get<Object>(copy->second);
 
-          if(isControlCode(ch))
+          for(const auto & [key, child] : *source.map)
           {
-           error =  makeError(ControlCharacterDetectionMsg, buffer);
-           return false;
+              JsonValue & slot = target.map->try_emplace(key).first->second;
+              *slot.value = *child.value;
+              pending.push_back(slot.value.get());
           }
+       }
+       else if(Array * array = std::get_if<Array>(node))
+       {
+          auto [copy, inserted] = copies.try_emplace(array->array.get(), Array());
+          const Array source = *array;
+          *node = copy->second;
+          if(!inserted) continue;
+
+          Array::Vector & target = *std::get<Array>(copy->second).array;
+          target.resize(source.array->size());
 
-          if(ch != value[i])
+          for(std::size_t i = 0; i < target.size(); i++)
           {
-             error =  makeError(InvalidValueMsg, buffer);
-             return false;
+              *target[i].value = *(*source.array)[i].value;
+              pending.push_back(target[i].value.get());
           }
+       }
+   }
 
-          i++;
-    }
+   return ret;
+}
 
-    if(i != value.size())
-    {
-       error =  makeError(ValueOutOfArrayMsg, buffer);
-       return false;
-    }
+JsonValue JsonValue::snapshot() const { return copy(); }
 
-    return true;
+JsonValue::Object & JsonValue::editObject()
+{
+   if(value->index() != static_cast<std::size_t>(JsonType::Object)) *value = Object();
+   Object & object = std::get<Object>(*value);
+   if(object.shared()) object = object.copy();
+   return object;
 }
 
-static bool ready(const unsigned char ch,
-                  std::stack<JsonReaderType> & depth,
-                  JsonSAXReader * self,
-                  JsonBufferReader & buffer,
-                  std::string & error)
+JsonValue::Array & JsonValue::editArray()
 {
-    if(ch == '{')
-    {
-       depth.push(JsonReaderType::Object);
-       self->ObjectBegin();
-    }
-    else if(ch == '[')
-    {
-       depth.push(JsonReaderType::Array);
-       self->ArrayBegin();
-    }
-    else if(ch == '"')
-    {
-       if(!readyStringValue(self, buffer, error)) return false;
-    }
-    else if(ch == '-' || std::isdigit(ch) != 0)
-    {
-       if(!readyNumber(ch, depth, self, buffer, error)) return false;
-    }
-    else if(ch == 't')
-    {
-       if(!readyValue("rue", buffer, error)) return false;
-       self->Value(true);
-    }
-    else if(ch == 'f')
-    {
-       if(!readyValue("alse", buffer, error)) return false;
-       self->Value(false);
-    }
-    else if(ch == 'n')
-    {
-       if(!readyValue("ull", buffer, error)) return false;
-       self->Null();
-    }
-    else
-    {
-       error =  makeError(InvalidValueMsg, buffer);
-       return false;
-    }
+   if(value->index() != static_cast<std::size_t>(JsonType::Array)) *value = Array();
+   Array & array = std::get<Array>(*value);
+   if(array.shared()) array = array.copy();
+   return array;
+}
 
-    return true;
+//a child handle is also held by the container copy a snapshot keeps
+JsonValue & JsonValue::detach()
+{
+   if(value.use_count() > 1)
+   {
+      std::shared_ptr<Value> shell = makeShell();
+      *shell = *value;
+      value = std::move(shell);
+   }
+   return *this;
 }
 
-//----------------------------------------------------------------
+JsonValue & JsonValue::edit(const std::string & key){ return editObject()[key].detach(); }
+JsonValue & JsonValue::edit(std::size_t index){ return editArray().at(index).detach(); }
 
-void JsonSAXReader::stopParse(){ stop = true; }
+bool JsonValue::indexKey(const JsonValue & item, const Array::Path & path, IndexKey & key)
+{
+   const Value * node = item.value.get();
 
-JsonSAXReader::JsonSAXReader(){}
-JsonSAXReader::~JsonSAXReader(){}
+   for(const std::string & step : path)
+   {
+       const Object * object = std::get_if<Object>(node);
+       if(object == nullptr) return false;
+
+       auto it = object->map->find(step);
+       if(it == object->map->end()) return false;
+       node = it->second.value.get();
+   }
 
-std::string JsonSAXReader::error() const { return std::move(_error); }
+   switch(static_cast<JsonType>(node->index()))
+   {
+       case JsonType::String: key = std::get<std::string>(*node); return true;
+       case JsonType::Double: key = std::get<double>(*node); return true;
+       case JsonType::LongLong: key = std::get<long long>(*node); return true;
+       case JsonType::Bool: key = std::get<bool>(*node); return true;
+       case JsonType::Null: key = nullptr; return true;
+       default: return false;
+   }
+}
 
-bool JsonSAXReader::parse(JsonBufferReader & buffer, Operation operation) //pop top
+JsonValue::Slot * JsonValue::slotOf(const Value & value)
 {
-    stop = false;
-    std::stack<JsonReaderType> depth;
+   if(const Object * object = std::get_if<Object>(&value)) return object->slot.get();
+   if(const Array * array = std::get_if<Array>(&value)) return array->slot.get();
+   return nullptr;
+}
 
-    while(buffer.next())
-    {
-        const unsigned char ch = buffer.value();
+std::atomic<std::uint64_t> JsonValue::hashEpoch = 1;
 
-        if(std::isspace(ch) != 0) continue;
+void JsonValue::forgetHash(Slot & slot)
+{
+   slot.hashed.store(0, std::memory_order_relaxed);
+   hashEpoch.fetch_add(1, std::memory_order_acq_rel);
+}
 
-        if(isControlCode(ch))
-        {
-           _error =  makeError(ControlCharacterDetectionMsg, buffer);
-           return false;
-        }
+//Calls step for the value and its ancestors while it returns true,
+//a cycle of links (left by edits) is detected by Brent's algorithm
+template<typename Step>
+static void walkUp(JsonValue node, Step && step)
+{
+   JsonValue mark = node;
+   std::size_t power = 1, steps = 0;
 
-        if(depth.empty())
-        {
-           if(ch == '{')
-           {
-              JsonBegin();
-              depth.push(JsonReaderType::Object);
-              ObjectBegin();
-           }
-           else if(ch == '[')
-           {
-              JsonBegin();
-              depth.push(JsonReaderType::Array);
-              ArrayBegin();
-           }
-           else
-           {
-              _error =  makeError(InvalidEntryCharacterMsg, ch, buffer);
-              return false;
-           }
-        }
-        else if(depth.top() == JsonReaderType::Object)
-        {
-           if(ch == '"')
-           {
-              if(!readyObjectKey(this, buffer, _error)) return false;
-              depth.top() = JsonReaderType::ObjectKey;
-           }
-           else if(ch == '}')
-           {
-              depth.pop();
-              ObjectEnd();
-           }
-           else
-           {
-              _error =  makeError(InvalidObjectKeyMsg, ch, buffer);
-              return false;
-           }
-        }
-        else if(depth.top() == JsonReaderType::ObjectKey)
-        {
-           if(ch == ':')
-           {
-              depth.top() = JsonReaderType::ObjectValue;
-           }
-           else
-           {
-              _error =  makeError(InvalidObjectKeyValueMsg, ch, buffer);
-              return false;
-           }
-        }
-        else if(depth.top() == JsonReaderType::ObjectValue)
-        {
-           depth.top() = JsonReaderType::ObjectNextPair;
-           if(!ready(ch, depth, this, buffer, _error)) return false;
-        }
-        else if(depth.top() == JsonReaderType::ObjectNextPair)
-        {
-           if(ch == ',')
-           {
-              depth.top() = JsonReaderType::ObjectNextKey;
-           }
-           else if(ch == '}')
-           {
-              depth.pop();
-              ObjectEnd();
-           }
-           else
-           {
-              _error =  makeError(InvalidSeparatorObjectMsg, buffer);
-              return false;
-           }
-        }
-        else if(depth.top() == JsonReaderType::ObjectNextKey)
-        {
-           if(ch == '"')
-           {
-              if(!readyObjectKey(this, buffer, _error)) return false;
-              depth.top() = JsonReaderType::ObjectKey;
-           }
-           else
-           {
-              _error = makeError(InvalidObjectKeyMsg, ch, buffer);
-              return false;
-           }
-        }
-        else if(depth.top() == JsonReaderType::Array)
-        {
-           if(ch == ']')
-           {
-              depth.pop();
-              ArrayEnd();
-           }
-           else
-           {
-              depth.top() = JsonReaderType::ArrayNext;
-              if(!ready(ch, depth, this, buffer, _error)) return false;
-           }
-        }
-        else if(depth.top() == JsonReaderType::ArrayNext)
-        {
-           if(ch == ',')
-           {
-              depth.top() = JsonReaderType::ArrayNextValue;
-           }
-           else if(ch == ']')
-           {
-              depth.pop();
-              ArrayEnd();
-           }
-           else
-           {
-              _error =  makeError(InvalidSeparatorArrayMsg, buffer);
-              return false;
-           }
-        }
-        else if(depth.top() == JsonReaderType::ArrayNextValue)
-        {
-           depth.top() = JsonReaderType::ArrayNext;
-           if(!ready(ch, depth, this, buffer, _error)) return false;
-        }
+   while(step(node))
+   {
+      node = node.parent();
+      if(node.isEmpty() || &node.getValue() == &mark.getValue()) return;
+
+      if(++steps == power)
+      {
+         mark = node;
+         power *= 2;
+         steps = 0;
+      }
+   }
+}
 
-        if(depth.empty())
-        {
-           JsonEnd();
-           if(operation == Single) break;
-           if(stop) break;
-        }
-    }
+//a container is linked when it is found first, the links form a tree even for shared containers
+void JsonValue::link() const
+{
+   std::unordered_set<const Slot *> linked = {slotOf(*value)};
+   std::vector<const std::shared_ptr<Value> *> pending = {&value};
 
-    if(!depth.empty())
-    {
-       _error = UnexpectedEndMsg;
-       return false;
-    }
+   while(!pending.empty())
+   {
+       const std::shared_ptr<Value> & node = *pending.back();
+       pending.pop_back();
 
-    return true;
+       auto linkChild = [&](const JsonValue & child)
+       {
+           Slot * slot = slotOf(*child.value);
+           if(slot == nullptr || !linked.insert(slot).second) return;
+           slot->parent = node;
+           pending.push_back(&child.value);
+       };
+
+       if(const Object * object = std::get_if<Object>(node.get())){ for(const auto & [key, child] : *object->map) linkChild(child); }
+       else if(const Array * array = std::get_if<Array>(node.get())){ for(const JsonValue & child : *array->array) linkChild(child); }
+   }
 }
 
-//----------------------------------------------------------------
+JsonValue JsonValue::parent() const
+{
+   JsonValue ret;
+   const Slot * slot = slotOf(*value);
+   if(slot == nullptr) return ret;
 
-JsonValue::Object::Object(){}
-JsonValue::Object::Object(const Map & map){ *this->map = map; }
-JsonValue::Object JsonValue::Object::copy() const
+   std::shared_ptr<Value> parent = slot->parent.lock();
+   if(parent) ret.value = std::move(parent);
+   return ret;
+}
+
+std::vector<JsonValue> JsonValue::ancestors() const
 {
-   Object ret;
-   *ret.map = *map;
+   std::vector<JsonValue> ret;
+   walkUp(parent(), [&ret](const JsonValue & node)
+   {
+      if(node.isEmpty()) return false;
+      ret.push_back(node);
+      return true;
+   });
    return ret;
 }
 
-std::size_t JsonValue::Object::count() const { return map->size(); }
-bool JsonValue::Object::contains(const std::string & key) const { return map->contains(key); }
-JsonValue JsonValue::Object::value(const std::string & key) const { return (map->contains(key)) ? map->operator[](key) : JsonValue(); }
-void JsonValue::Object::insert(const std::string & key, const JsonValue & value) const { map->insert({key, value}); }
-void JsonValue::Object::remove(const std::string & key){ map->erase(key); }
-void JsonValue::Object::clear(){ map->clear(); }
-JsonValue & JsonValue::Object::operator [](const std::string & key) const { return map->operator[](key); }
-const JsonValue::Object::Map & JsonValue::Object::getMap() const { return *map; }
-JsonValue::Object::Map & JsonValue::Object::getMap(){ return *map; }
+JsonValue JsonValue::resolve(const std::string & key) const
+{
+   JsonValue ret;
+   walkUp(*this, [&ret, &key](const JsonValue & node)
+   {
+      const Object * object = std::get_if<Object>(node.value.get());
+      if(object == nullptr) return true;
 
-JsonValue::Object::operator const Map &() const { return *map; }
-JsonValue::Object::operator Map &(){ return *map; }
+      auto it = object->map->find(key);
+      if(it == object->map->end()) return true;
 
-void JsonValue::Object::setMap(const Map & map){ *this->map = map; }
-JsonValue::Object & JsonValue::Object::operator = (const Map & map)
+      ret = it->second;
+      return false;
+   });
+   return ret;
+}
+
+void JsonValue::search(const Visitor & visitor, JsonSearch order) const
 {
-   *this->map = map;
-   return *this;
+   struct Entry
+   {
+       const JsonValue * value;
+       const std::string * key;
+       std::size_t depth;
+   };
+
+   static const std::string noKey;
+   std::deque<Entry> pending = {{this, &noKey, 0}};
+   std::unordered_set<const void *> entered;
+
+   while(!pending.empty())
+   {
+       Entry entry;
+
+       if(order == JsonSearch::DepthFirst)
+       {
+          entry = pending.back();
+          pending.pop_back();
+       }
+       else
+       {
+          entry = pending.front();
+          pending.pop_front();
+       }
+
+       if(!visitor(*entry.value, *entry.key, entry.depth)) return;
+
+       const Value & node = *entry.value->value;
+       std::size_t depth = entry.depth + 1;
+
+       //depth-first pops from the back: children are pushed in reverse to come out in document order
+       if(const Object * object = std::get_if<Object>(&node))
+       {
+          if(!entered.insert(object->map.get()).second) continue;
+          if(order == JsonSearch::DepthFirst){ for(auto it = object->map->rbegin(); it != object->map->rend(); ++it) pending.push_back({&it->second, &it->first, depth}); }
+          else { for(const auto & [key, child] : *object->map) pending.push_back({&child, &key, depth}); }
+       }
+       else if(const Array * array = std::get_if<Array>(&node))
+       {
+          if(!entered.insert(array->array.get()).second) continue;
+          if(order == JsonSearch::DepthFirst){ for(auto it = array->array->rbegin(); it != array->array->rend(); ++it) pending.push_back({&*it, &noKey, depth}); }
+          else { for(const JsonValue & child : *array->array) pending.push_back({&child, &noKey, depth}); }
+       }
+   }
 }
 
-//----------------------
+std::vector<JsonValue> JsonValue::find(const std::string & key, JsonSearch order) const
+{
+   std::vector<JsonValue> ret;
+   search([&ret, &key](const JsonValue & value, const std::string &, std::size_t)
+   {
+      if(const Object * object = std::get_if<Object>(value.value.get()))
+      {
+          auto it = object->map->find(key);
+          if(it != object->map->end()) ret.push_back(it->second);
+      }
+      return true;
+   }, order);
+   return ret;
+}
 
-JsonValue::Array::Array(){}
-JsonValue::Array::Array(const Vector & array){ *this->array = array; }
-JsonValue::Array JsonValue::Array::copy() const
+std::vector<JsonValue> JsonValue::find(const std::function<bool(const JsonValue &)> & predicate, JsonSearch order) const
 {
-   Array ret;
-   *ret.array = *array;
+   std::vector<JsonValue> ret;
+   search([&ret, &predicate](const JsonValue & value, const std::string &, std::size_t)
+   {
+      if(predicate(value)) ret.push_back(value);
+      return true;
+   }, order);
    return ret;
 }
 
-std::size_t JsonValue::Array::count() const { return array->size(); }
-JsonValue & JsonValue::Array::at(std::size_t index) const { return array->at(index); }
-void JsonValue::Array::append(const JsonValue & value){ array->push_back(value); }
-void JsonValue::Array::clear(){ array->clear(); }
-JsonValue & JsonValue::Array::operator[](std::size_t index) const { return array->at(index); }
-const JsonValue::Array::Vector & JsonValue::Array::getVector() const { return *array; }
-JsonValue::Array::Vector & JsonValue::Array::getVector(){ return *array; }
+//64-bit finalizer of MurmurHash3, std::hash of integers is the identity
+static std::uint64_t mixHash(std::uint64_t value)
+{
+   value ^= value >> 33;
+   value *= 0xff51afd7ed558ccdULL;
+   value ^= value >> 33;
+   value *= 0xc4ceb9fe1a85ec53ULL;
+   return value ^ (value >> 33);
+}
 
-JsonValue::Array::operator const Vector &() const{ return *array; }
-JsonValue::Array::operator Vector &() { return *array; }
+static std::uint64_t combineHash(std::uint64_t seed, std::uint64_t value){ return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)); }
 
-void JsonValue::Array::setVector(const Vector & vector){ *array = vector; }
-JsonValue::Array & JsonValue::Array::operator = (const Vector & vector)
+bool JsonValue::scalarEqual(const Value & first, const Value & second)
 {
-   *array = vector;
-   return *this;
+   if(first.index() != second.index()) return false;
+
+   switch(static_cast<JsonType>(first.index()))
+   {
+      case JsonType::String: return std::get<std::string>(first) == std::get<std::string>(second);
+      case JsonType::Double:
+      {
+         const double a = std::get<double>(first);
+         const double b = std::get<double>(second);
+         return a == b || (std::isnan(a) && std::isnan(b));
+      }
+      case JsonType::LongLong: return std::get<long long>(first) == std::get<long long>(second);
+      case JsonType::Bool: return std::get<bool>(first) == std::get<bool>(second);
+      case JsonType::Raw: return std::get<Raw>(first).json == std::get<Raw>(second).json;
+      default: return true;
+   }
 }
 
-//----------------------
+//the type is a part of the hash, equal values hash equally: 0.0 and -0.0, every NaN
+static std::uint64_t scalarHash(const JsonValue::Value & value)
+{
+   std::uint64_t hash;
 
-JsonValue::JsonValue(){}
-JsonValue::JsonValue(const Object & object){ *value = object; }
-JsonValue::JsonValue(const Array & array){ *value = array; }
-JsonValue::JsonValue(char c){ setString(c); }
-JsonValue::JsonValue(const char * string){ setString(string); }
-JsonValue::JsonValue(std::string_view string){ setString(string); }
-JsonValue::JsonValue(const std::string & string){ *value = string; }
-JsonValue::JsonValue(float val){ setDouble(val); }
-JsonValue::JsonValue(double val){ *value = val; }
-JsonValue::JsonValue(unsigned char val){ setLongLong(val); }
-JsonValue::JsonValue(short val){ setLongLong(val); }
-JsonValue::JsonValue(unsigned short val){ setLongLong(val); }
-JsonValue::JsonValue(int val){ setLongLong(val); }
-JsonValue::JsonValue(unsigned int val){ setLongLong(val); }
-JsonValue::JsonValue(long long val){ *value = val; }
-JsonValue::JsonValue(bool val){ *value = val; }
-JsonValue::JsonValue(std::nullptr_t){ *value = std::nullptr_t(); }
+   switch(static_cast<JsonType>(value.index()))
+   {
+      case JsonType::String: hash = std::hash<std::string>()(std::get<std::string>(value));
+      break;
+      case JsonType::Double:
+      {
+         const double number = std::get<double>(value);
+         hash = (number == 0) ? 0 : (std::isnan(number)) ? 1 : std::bit_cast<std::uint64_t>(number);
+      }
+      break;
+      case JsonType::LongLong: hash = static_cast<std::uint64_t>(std::get<long long>(value));
+      break;
+      case JsonType::Bool: hash = std::get<bool>(value);
+      break;
+      case JsonType::Raw: hash = std::hash<std::string>()(std::get<JsonValue::Raw>(value).json);
+      break;
+      default: hash = 0;
+   }
 
-JsonValue JsonValue::copy() const
+   return mixHash(combineHash(value.index(), hash));
+}
+
+std::size_t JsonValue::hash(bool memoize) const
 {
-   JsonValue ret;
-   *ret.value = *value;
-   return ret;
+   struct Frame
+   {
+       const Object::Map * map = nullptr;
+       Object::Map::const_iterator pos;
+       const Array::Vector * array = nullptr;
+       std::size_t index = 0;
+       Slot * slot = nullptr;
+       std::uint64_t hash = 0;
+   };
+
+   std::vector<Frame> frames;
+   //a change during a memoizing call leaves the hashes it writes behind the epoch
+   const std::uint64_t epoch = hashEpoch.load(std::memory_order_acquire);
+
+   //false - the container is entered, its hash is ready when its frame is done
+   auto enter = [&frames, epoch](const Value & node, std::uint64_t & hash)
+   {
+       Frame frame;
+       frame.slot = slotOf(node);
+
+       if(frame.slot == nullptr)
+       {
+          hash = scalarHash(node);
+          return true;
+       }
+
+       if(frame.slot->hashed.load(std::memory_order_acquire) == epoch)
+       {
+          hash = frame.slot->hash;
+          return true;
+       }
+
+       if(const Object * object = std::get_if<Object>(&node))
+       {
+          frame.map = object->map.get();
+          frame.pos = frame.map->begin();
+          frame.hash = combineHash(node.index(), frame.map->size());
+       }
+       else
+       {
+          frame.array = std::get<Array>(node).array.get();
+          frame.hash = combineHash(node.index(), frame.array->size());
+       }
+
+       frames.push_back(frame);
+       return false;
+   };
+
+   std::uint64_t hash = 0;
+   if(enter(*value, hash)) return hash;
+
+   while(!frames.empty())
+   {
+       Frame & frame = frames.back();
+       const Value * child = nullptr;
+
+       //the pairs of a map come sorted by key, the hash does not depend on the insertion order
+       if(frame.map != nullptr && frame.pos != frame.map->end())
+       {
+          frame.hash = combineHash(frame.hash, std::hash<std::string>()(frame.pos->first));
+          child = frame.pos->second.value.get();
+          ++frame.pos;
+       }
+       else if(frame.array != nullptr && frame.index < frame.array->size()) child = (*frame.array)[frame.index++].value.get();
+
+       if(child != nullptr)
+       {
+          if(enter(*child, hash)) frame.hash = combineHash(frame.hash, hash);
+          continue;
+       }
+
+       hash = mixHash(frame.hash);
+
+       if(memoize)
+       {
+          frame.slot->hash = hash;
+          frame.slot->hashed.store(epoch, std::memory_order_release);
+       }
+
+       frames.pop_back();
+       if(!frames.empty()) frames.back().hash = combineHash(frames.back().hash, hash);
+   }
+
+   return hash;
+}
+
+bool JsonValue::equal(const Value & first, const Value & second)
+{
+   std::vector<std::pair<const Value *, const Value *>> pending = {{&first, &second}};
+
+   while(!pending.empty())
+   {
+       auto [left, right] = pending.back();
+       pending.pop_back();
+       if(left == right) continue;
+
+       const Slot * a = slotOf(*left);
+       const Slot * b = slotOf(*right);
+
+       if(a == nullptr || b == nullptr)
+       {
+          if(!scalarEqual(*left, *right)) return false;
+          continue;
+       }
+
+       if(a == b) continue; //one container, a slot shares the allocation of its map or vector
+       if(left->index() != right->index() || (a->memoized() && b->memoized() && a->hash != b->hash)) return false;
+
+       if(const Object * object = std::get_if<Object>(left))
+       {
+          const Object::Map & x = *object->map;
+          const Object::Map & y = *std::get<Object>(*right).map;
+          if(x.size() != y.size()) return false;
+
+          for(auto i = x.begin(), j = y.begin(); i != x.end(); ++i, ++j)
+          {
+              if(i->first != j->first) return false;
+              if(i->second.value != j->second.value) pending.emplace_back(i->second.value.get(), j->second.value.get());
+          }
+       }
+       else
+       {
+          const Array::Vector & x = *std::get<Array>(*left).array;
+          const Array::Vector & y = *std::get<Array>(*right).array;
+          if(x.size() != y.size()) return false;
+
+          for(std::size_t i = 0; i < x.size(); i++)
+          {
+              if(x[i].value != y[i].value) pending.emplace_back(x[i].value.get(), y[i].value.get());
+          }
+       }
+   }
+
+   return true;
 }
 
+bool JsonValue::operator==(const JsonValue & other) const { return equal(*value, *other.value); }
+
 JsonType JsonValue::type() const { return static_cast<JsonType>(value->index()); }
 bool JsonValue::isEmpty() const { return (value->index() == 0); }
 
@@ -690,11 +876,17 @@ JsonValue::Value & JsonValue::getValue(){ return *value; }
 JsonValue::operator const Value &() const { return *value; }
 JsonValue::operator Value &() { return *value; }
 void JsonValue::setValue(const Value & value) { *this->value = value; }
+void JsonValue::setValue(Value && value) { *this->value = std::move(value); }
 JsonValue & JsonValue::operator = (const Value & value)
 {
    *this->value = value;
    return *this;
 }
+JsonValue & JsonValue::operator = (Value && value)
+{
+   *this->value = std::move(value);
+   return *this;
+}
 
 JsonValue::Object JsonValue::getObject() const { return (value->index() == 1) ? std::get<1>(*value.get()) : Object(); }
 void JsonValue::setObject(const Object & object){ *value = object; }
@@ -722,7 +914,7 @@ std::string JsonValue::getString() const
     case 3: return std::get<3>(*value.get());
     case 4:
     {
-       std::array<char, 18> data;
+       std::array<char, DOUBLE_TEXT> data;
        auto [ptr, ec] = std::to_chars(data.data(), data.data() + data.size(), std::get<4>(*value.get()));
        if(ec != std::errc()) return std::string();
        return std::string(data.data(), ptr);
@@ -744,6 +936,7 @@ void JsonValue::setString(char c){ *value = std::string(&c, 1); }
 void JsonValue::setString(const char * string){ *value = std::string(string); }
 void JsonValue::setString(std::string_view string){ *value = std::string(string); }
 void JsonValue::setString(const std::string & string){ *value = string; }
+void JsonValue::setString(std::string && string){ *value = std::move(string); }
 JsonValue::operator std::string() const { return getString(); }
 JsonValue & JsonValue::operator = (char c)
 {
@@ -765,6 +958,11 @@ JsonValue & JsonValue::operator = (const std::string & string)
    *value = string;
    return *this;
 }
+JsonValue & JsonValue::operator = (std::string && string)
+{
+   *value = std::move(string);
+   return *this;
+}
 double JsonValue::getDouble() const { return (value->index() == 4) ? std::get<4>(*value.get()) : 0.0; }
 void JsonValue::setDouble(float val){  *value = static_cast<double>(val);  }
 void JsonValue::setDouble(double val){ *value = val; }
@@ -832,36 +1030,98 @@ JsonValue & JsonValue::operator = (std::nullptr_t)
    *value = std::nullptr_t();
    return *this;
 }
+JsonValue::Raw JsonValue::getRaw() const { return (value->index() == 8) ? std::get<8>(*value.get()) : Raw(); }
+void JsonValue::setRaw(const Raw & raw){ *value = raw; }
+void JsonValue::setRaw(Raw && raw){ *value = std::move(raw); }
+JsonValue & JsonValue::operator = (const Raw & raw)
+{
+   *value = raw;
+   return *this;
+}
+JsonValue & JsonValue::operator = (Raw && raw)
+{
+   *value = std::move(raw);
+   return *this;
+}
 
 //----------------------------------------------------------------
 
-void JsonReader::insertValue(JsonValue & value)
+#if defined(JSON_STATS)
+static const std::size_t smallString = std::string().capacity();
+#endif
+
+void JsonReader::insertValue(JsonValue && value)
 {
-    if(!key.empty())
+    constexpr int objectIndex = static_cast<int>(JsonType::Object);
+    constexpr int arrayIndex = static_cast<int>(JsonType::Array);
+
+    //the value shell, the map node (and the key beyond the small string buffer) or the growth of the vector
+    JSON_STAT(_stats.allocations++);
+
+    //the key is copied once into the node, the key buffer keeps its capacity for the next key
+    if(JsonValue::Object * obj = std::get_if<objectIndex>(stack.top().get()))
     {
-       constexpr int index = static_cast<int>(JsonType::Object);
-       JsonValue::Object obj = std::get<index>(*stack.top());
-       obj.map->insert({std::move(key), value});
+       JSON_STAT(_stats.allocations += 1 + (key.size() > smallString));
+       obj->map->try_emplace(key, std::move(value));
     }
     else
     {
-       constexpr int index = static_cast<int>(JsonType::Array);
-       JsonValue::Array array = std::get<index>(*stack.top());
-       array.array->push_back(value);
+       JsonValue::Array::Vector & array = *std::get<arrayIndex>(*stack.top()).array;
+       JSON_STAT(_stats.allocations += (array.size() == array.capacity()));
+       array.push_back(std::move(value));
+    }
+}
+
+bool JsonReader::beginRaw()
+{
+    if(rawLevel > 0)
+    {
+       rawLevel++;
+       return true;
     }
+
+    if(!rawInput || stack.empty() || stack.top()->index() != static_cast<std::size_t>(JsonType::Object) || !rawKeys.contains(key)) return false;
+
+    //nodes are built when the reader does not keep its input
+    std::string bracket;
+    if(!source->copy(source->offset(), source->offset(), bracket)) return false;
+
+    rawStart = source->offset();
+    rawLevel = 1;
+    return true;
+}
+
+void JsonReader::endRaw()
+{
+    if(--rawLevel > 0) return;
+
+    JsonValue value;
+    *value.value = JsonValue::Raw();
+    source->copy(rawStart, source->offset(), std::get<JsonValue::Raw>(*value.value).json);
+    insertValue(std::move(value));
 }
 
 JsonReader::JsonReader(){}
 
-bool JsonReader::parse(JsonBufferReader & buffer, const std::function<bool(JsonValue &)> & resultCallback, Operation operation)
+void JsonReader::setRawKeys(const std::unordered_set<std::string> & keys){ rawKeys = keys; }
+void JsonReader::setParentLinks(bool links){ parentLinks = links; }
+void JsonReader::setIndexKeys(const std::unordered_map<std::string, JsonValue::Array::Path> & keys){ indexKeys = keys; }
+void JsonReader::setMemoryResource(std::pmr::memory_resource * resource){ this->resource = resource; }
+
+bool JsonReader::parse(JsonBufferReader & buffer, Callback resultCallback, Operation operation, JsonFormat format)
 {
     if(!resultCallback) return false;
     callback = resultCallback;
+    source = &buffer;
+    JsonValue::MemoryScope scope((resource != nullptr) ? resource : JsonValue::memoryResource());
+    rawInput = ((format == JsonFormat::Text || format == JsonFormat::Canonical) && !rawKeys.empty());
 
-    if(!JsonSAXReader::parse(buffer, operation))
+    if(!JsonSAXParser::parse(*this, buffer, operation, format))
     {
+       //the resource may be exhausted: the partial tree is dropped without allocating a new shell,
+       //every document sets the root again when its first container begins
        while(!stack.empty()) stack.pop();
-       root = JsonValue();
+       root.value.reset();
        key.clear();
        return false;
     }
@@ -869,55 +1129,56 @@ bool JsonReader::parse(JsonBufferReader & buffer, const std::function<bool(JsonV
     return true;
 }
 
-bool JsonReader::parse(std::string_view json, const std::function<bool (JsonValue &)> &resultCallback, Operation operation)
+bool JsonReader::parse(std::string_view json, Callback resultCallback, Operation operation, JsonFormat format)
 {
     JsonStringViewBufferReader buffer(json);
-    return parse(buffer, resultCallback, operation);
+    return parse(buffer, resultCallback, operation, format);
 }
 
-JsonValue JsonReader::parse(JsonBufferReader & buffer)
+JsonValue JsonReader::parse(JsonBufferReader & buffer, JsonFormat format)
 {
     JsonValue ret;
     parse(buffer, [&ret](JsonValue & value)
     {
        ret = value;
        return true;
-    });
+    }, Single, format);
     return ret;
 }
 
-JsonValue JsonReader::parse(std::string_view json)
+JsonValue JsonReader::parse(std::string_view json, JsonFormat format)
 {
     JsonValue ret;
     parse(json, [&ret](JsonValue & value)
     {
        ret = value;
        return true;
-    });
+    }, Single, format);
     return ret;
 }
 
-bool JsonReader::parseFromFile(const std::string & fileName, const std::function<bool (JsonValue &)> &resultCallback, Operation operation)
+bool JsonReader::parseFromFile(const std::string & fileName, Callback resultCallback, Operation operation, JsonFormat format)
 {
     JsonFileBufferReader buffer;
-    if(!buffer.open(fileName) || !parse(buffer, resultCallback, operation)) return false;
+    if(!buffer.open(fileName) || !parse(buffer, resultCallback, operation, format)) return false;
     return true;
 }
 
-JsonValue JsonReader::parseFromFile(const std::string & fileName)
+JsonValue JsonReader::parseFromFile(const std::string & fileName, JsonFormat format)
 {
     JsonValue ret;
     parseFromFile(fileName, [&ret](JsonValue & value)
     {
        ret = value;
        return true;
-    });
+    }, Single, format);
     return ret;
 }
 
 void JsonReader::JsonBegin()
 {
     while(!stack.empty()) stack.pop();
+    rawLevel = 0;
 }
 
 void JsonReader::JsonEnd()
@@ -928,75 +1189,117 @@ void JsonReader::JsonEnd()
 
 void JsonReader::ObjectBegin()
 {
+    if(beginRaw()) return;
+
     JsonValue value;
     *value.value = JsonValue::Object();
+    JSON_STAT(_stats.allocations++); //node
 
     if(stack.empty())
     {
+       JSON_STAT(_stats.allocations++); //shell
        root = value;
        stack.push(std::move(value.value));
        return;
     }
 
-    insertValue(value);
-    stack.push(std::move(value.value));
+    if(parentLinks) std::get<JsonValue::Object>(*value.value).slot->parent = stack.top();
+
+    std::shared_ptr<JsonValue::Value> container = value.value;
+    insertValue(std::move(value));
+    stack.push(std::move(container));
 }
 
-void JsonReader::ObjectKey(const std::string & key){ this->key = std::move(key); }
+void JsonReader::ObjectKey(const std::string & key){ if(rawLevel == 0) this->key = key; }
 
-void JsonReader::ObjectEnd(){ stack.pop(); }
+void JsonReader::ObjectEnd()
+{
+    if(rawLevel > 0) endRaw();
+    else stack.pop();
+}
 
 void JsonReader::ArrayBegin()
 {
+    if(beginRaw()) return;
+
     JsonValue value;
     *value.value = JsonValue::Array();
+    JSON_STAT(_stats.allocations++); //node
 
     if(stack.empty())
     {
+       JSON_STAT(_stats.allocations++); //shell
        root = value;
        stack.push(std::move(value.value));
        return;
     }
 
-    insertValue(value);
-    stack.push(std::move(value.value));
+    if(parentLinks) std::get<JsonValue::Array>(*value.value).slot->parent = stack.top();
+
+    if(!indexKeys.empty() && stack.top()->index() == static_cast<std::size_t>(JsonType::Object))
+    {
+       auto it = indexKeys.find(key);
+       if(it != indexKeys.end()) std::get<JsonValue::Array>(*value.value).addIndex(it->second); //stale, built in ArrayEnd
+    }
+
+    std::shared_ptr<JsonValue::Value> container = value.value;
+    insertValue(std::move(value));
+    stack.push(std::move(container));
 }
 
-void JsonReader::ArrayEnd(){ stack.pop(); }
+void JsonReader::ArrayEnd()
+{
+    if(rawLevel > 0)
+    {
+       endRaw();
+       return;
+    }
+
+    //the index is built once the items are complete
+    JsonValue::Array & array = std::get<JsonValue::Array>(*stack.top());
+    if(array.slot->indexes) array.index(array.slot->indexes->front().path);
+    stack.pop();
+}
 
 void JsonReader::Value(const std::string & value)
 {
+    if(rawLevel > 0) return;
     JsonValue val;
     *val.value = value;
-    insertValue(val);
+    JSON_STAT(_stats.allocations += (value.size() > smallString));
+    insertValue(std::move(val));
 }
 
 void JsonReader::Value(double value)
 {
+    if(rawLevel > 0) return;
     JsonValue val;
     *val.value = value;
-    insertValue(val);
+    insertValue(std::move(val));
 }
 
 void JsonReader::Value(long long value)
 {
+    if(rawLevel > 0) return;
     JsonValue val;
     *val.value = value;
-    insertValue(val);
+    insertValue(std::move(val));
 }
 
 void JsonReader::Value(bool value)
 {
+    if(rawLevel > 0) return;
     JsonValue val;
     *val.value = value;
-    insertValue(val);
+    insertValue(std::move(val));
 }
 
 void JsonReader::Null()
 {
+    if(rawLevel > 0) return;
     JsonValue val;
     *val.value = nullptr;
-    insertValue(val);
+    insertValue(std::move(val));
 }
 
 //----------------------------------------------------------------
@@ -1010,10 +1313,19 @@ bool JsonStringBufferWriter::write(unsigned char ch)
     return true;
 }
 
+bool JsonStringBufferWriter::writeData(std::string_view data)
+{
+    count += data.size();
+    json.append(data);
+    return true;
+}
+
 std::size_t JsonStringBufferWriter::writeCount(){ return count; }
 
 const std::string & JsonStringBufferWriter::result() const { return json; }
 
+void JsonStringBufferWriter::reserve(std::size_t size){ json.reserve(size); }
+
 //--------------
 
 JsonFileBufferWriter::JsonFileBufferWriter(){}
@@ -1022,7 +1334,7 @@ bool JsonFileBufferWriter::open(const std::string &fileName)
 {
     count = 0;
     if(stream.is_open()) stream.close();
-    stream.open(fileName);
+    stream.open(fileName, std::ios::out | std::ios::binary);
     is_open = stream.is_open();
     return is_open;
 }
@@ -1037,8 +1349,97 @@ bool JsonFileBufferWriter::write(unsigned char ch)
     return true;
 }
 
+bool JsonFileBufferWriter::writeData(std::string_view data)
+{
+    if(!is_open) return false;
+    stream.write(data.data(), data.size());
+    count += data.size();
+    return true;
+}
+
 std::size_t JsonFileBufferWriter::writeCount(){ return count; };
 
+//--------------
+
+JsonBufferPool::JsonBufferPool(std::size_t blockSize):_blockSize(std::max<std::size_t>(blockSize, 1)){}
+
+std::size_t JsonBufferPool::blockSize() const { return _blockSize; }
+
+std::unique_ptr<char[]> JsonBufferPool::take()
+{
+    if(blocks.empty()) return std::make_unique_for_overwrite<char[]>(_blockSize);
+    std::unique_ptr<char[]> block = std::move(blocks.back());
+    blocks.pop_back();
+    return block;
+}
+
+void JsonBufferPool::give(std::unique_ptr<char[]> block){ blocks.push_back(std::move(block)); }
+
+//--------------
+
+JsonChainBufferWriter::JsonChainBufferWriter(JsonBufferPool * pool, std::size_t referenceSize):
+    pool((pool != nullptr) ? pool : &ownPool), referenceSize(referenceSize){}
+
+JsonChainBufferWriter::~JsonChainBufferWriter(){ clear(); }
+
+bool JsonChainBufferWriter::write(unsigned char ch)
+{
+    const char c = static_cast<char>(ch);
+    return writeData(std::string_view(&c, 1));
+}
+
+bool JsonChainBufferWriter::writeData(std::string_view data)
+{
+    const std::size_t blockSize = pool->blockSize();
+    count += data.size();
+
+    while(!data.empty())
+    {
+       if(blocks.empty() || used == blockSize)
+       {
+          blocks.push_back(pool->take());
+          used = 0;
+       }
+
+       char * pos = blocks.back().get() + used;
+       const std::size_t size = std::min(data.size(), blockSize - used);
+       std::memcpy(pos, data.data(), size);
+
+       //Extend the last segment when it ends at the write position of the same block
+       if(used > 0 && !_segments.empty() && static_cast<char *>(_segments.back().iov_base) + _segments.back().iov_len == pos)
+       {
+          _segments.back().iov_len += size;
+       }
+       else _segments.push_back({pos, size});
+
+       used += size;
+       data.remove_prefix(size);
+    }
+
+    return true;
+}
+
+bool JsonChainBufferWriter::writeReference(std::string_view data)
+{
+    if(data.size() < referenceSize) return writeData(data);
+    count += data.size();
+    _segments.push_back({const_cast<char *>(data.data()), data.size()});
+    return true;
+}
+
+std::size_t JsonChainBufferWriter::writeCount(){ return count; }
+
+const std::vector<JsonSegment> & JsonChainBufferWriter::segments() const { return _segments; }
+
+void JsonChainBufferWriter::clear()
+{
+    for(std::unique_ptr<char[]> & block : blocks) pool->give(std::move(block));
+    blocks.clear();
+    _segments.clear();
+    used = 0;
+    count = 0;
+}
+
 //----------------------------------------------------------------
 
 static const char * const InvalidBuffer = "Invalid buffer",
@@ -1046,7 +1447,12 @@ static const char * const InvalidBuffer = "Invalid buffer",
                   * const ErrorConvDouble = "Error converting double to string",
                   * const ErrorConvLongLong = "Error converting long long to string",
                   * const ControlCharacterDetect = "Control character detection",
-                  * const BufferEnding = "Buffer ending";
+                  * const BufferEnding = "Buffer ending",
+                  * const ContainerSizeMismatch = "Container size does not match the number of items",
+                  * const ContainerSizeRange = "Container or string size out of range",
+                  * const CanonicalKeyOrder = "Keys of canonical json are not in UTF-16 order",
+                  * const CanonicalString = "String of canonical json is not valid UTF-8",
+                  * const CanonicalNumber = "NaN and infinities have no canonical json text";
 
 bool JsonSAXWriter::checkBuffer()
 {
@@ -1073,379 +1479,2206 @@ bool JsonSAXWriter::writeChar(unsigned char ch)
        return false;
     }
 
-    return true;
-}
+    return true;
+}
+
+bool JsonSAXWriter::writeByte(unsigned char ch)
+{
+    if(pendingDepth > 0)
+    {
+       pending.push_back(static_cast<char>(ch));
+       return true;
+    }
+
+    if(!buffer->write(ch))
+    {
+       _error = BufferEnding;
+       return false;
+    }
+
+    return true;
+}
+
+bool JsonSAXWriter::writeBigEndian(std::uint64_t value, std::size_t size)
+{
+    for(std::size_t i = size; i > 0; i--){ if(!writeByte(static_cast<unsigned char>(value >> (8 * (i - 1))))) return false; }
+    return true;
+}
+
+bool JsonSAXWriter::writeHeader(unsigned char major, std::uint64_t value)
+{
+    major <<= 5;
+    if(value < 24) return writeByte(major | static_cast<unsigned char>(value));
+    if(value <= 0xff) return writeByte(major | 24) && writeBigEndian(value, 1);
+    if(value <= 0xffff) return writeByte(major | 25) && writeBigEndian(value, 2);
+    if(value <= 0xffffffff) return writeByte(major | 26) && writeBigEndian(value, 4);
+    return writeByte(major | 27) && writeBigEndian(value, 8);
+}
+
+static std::size_t messagePackContainerHeader(bool object, std::size_t size, std::array<unsigned char, 5> & data)
+{
+    if(size < 16)
+    {
+       data[0] = static_cast<unsigned char>(((object) ? 0x80 : 0x90) | size);
+       return 1;
+    }
+
+    std::size_t count = 4;
+    if(size <= 0xffff)
+    {
+       data[0] = (object) ? 0xde : 0xdc;
+       count = 2;
+    }
+    else if(size <= 0xffffffff) data[0] = (object) ? 0xdf : 0xdd;
+    else return 0;
+
+    for(std::size_t i = 0; i < count; i++) data[i + 1] = static_cast<unsigned char>(size >> (8 * (count - i - 1)));
+    return count + 1;
+}
+
+bool JsonSAXWriter::binaryItem(bool key, bool container)
+{
+    if(frames.empty())
+    {
+       if(key || !container)
+       {
+          _error = InvalidOperation;
+          return false;
+       }
+
+       return true;
+    }
+
+    BinaryFrame & top = frames.top();
+
+    if(top.object)
+    {
+       if(top.key == key)
+       {
+          _error = InvalidOperation;
+          return false;
+       }
+
+       //pairs are counted by their keys
+       if(!key)
+       {
+          top.key = false;
+          return true;
+       }
+    }
+    else if(key)
+    {
+       _error = InvalidOperation;
+       return false;
+    }
+
+    if(top.count == top.size)
+    {
+       _error = ContainerSizeMismatch;
+       return false;
+    }
+
+    top.key = key;
+    top.count++;
+    return true;
+}
+
+bool JsonSAXWriter::binaryBegin(bool object, std::size_t size)
+{
+    if(format == JsonFormat::MessagePack)
+    {
+       if(size == UnknownSize)
+       {
+          //The header is inserted by binaryEnd when the number of items is known
+          if(pendingDepth++ == 0) pending.clear();
+          frames.push({size, 0, pending.size(), object, false});
+          return true;
+       }
+
+       std::array<unsigned char, 5> data;
+       const std::size_t count = messagePackContainerHeader(object, size, data);
+
+       if(count == 0)
+       {
+          _error = ContainerSizeRange;
+          return false;
+       }
+
+       for(std::size_t i = 0; i < count; i++){ if(!writeByte(data[i])) return false; }
+    }
+    else if(size == UnknownSize)
+    {
+       if(!writeByte((object) ? 0xbf : 0x9f)) return false;
+    }
+    else if(!writeHeader((object) ? 5 : 4, size)) return false;
+
+    frames.push({size, 0, 0, object, false});
+    return true;
+}
+
+bool JsonSAXWriter::binaryEnd(bool object)
+{
+    if(frames.empty() || frames.top().object != object || frames.top().key)
+    {
+       _error = InvalidOperation;
+       return false;
+    }
+
+    const BinaryFrame frame = frames.top();
+    frames.pop();
+
+    if(frame.size != UnknownSize)
+    {
+       if(frame.count != frame.size)
+       {
+          _error = ContainerSizeMismatch;
+          return false;
+       }
+
+       return true;
+    }
+
+    if(format == JsonFormat::CBOR) return writeByte(0xff);
+
+    std::array<unsigned char, 5> data;
+    const std::size_t count = messagePackContainerHeader(object, frame.count, data);
+
+    if(count == 0)
+    {
+       _error = ContainerSizeRange;
+       return false;
+    }
+
+    pending.insert(frame.offset, reinterpret_cast<const char *>(data.data()), count);
+    if(--pendingDepth > 0) return true;
+
+    for(unsigned char ch : pending)
+    {
+        if(!buffer->write(ch))
+        {
+           _error = BufferEnding;
+           return false;
+        }
+    }
+
+    pending.clear();
+    return true;
+}
+
+bool JsonSAXWriter::binaryString(const std::string & string)
+{
+    const std::size_t size = string.size();
+
+    if(format == JsonFormat::CBOR)
+    {
+       if(!writeHeader(3, size)) return false;
+    }
+    else if(size < 32)
+    {
+       if(!writeByte(static_cast<unsigned char>(0xa0 | size))) return false;
+    }
+    else if(size <= 0xff)
+    {
+       if(!writeByte(0xd9) || !writeBigEndian(size, 1)) return false;
+    }
+    else if(size <= 0xffff)
+    {
+       if(!writeByte(0xda) || !writeBigEndian(size, 2)) return false;
+    }
+    else if(size <= 0xffffffff)
+    {
+       if(!writeByte(0xdb) || !writeBigEndian(size, 4)) return false;
+    }
+    else
+    {
+       _error = ContainerSizeRange;
+       return false;
+    }
+
+    for(unsigned char ch : string){ if(!writeByte(ch)) return false; }
+    return true;
+}
+
+bool JsonSAXWriter::binaryInteger(long long value)
+{
+    if(format == JsonFormat::CBOR)
+    {
+       if(value >= 0) return writeHeader(0, static_cast<std::uint64_t>(value));
+       return writeHeader(1, static_cast<std::uint64_t>(-1 - value));
+    }
+
+    if(value >= 0)
+    {
+       if(value < 128) return writeByte(static_cast<unsigned char>(value));
+       if(value <= 0xff) return writeByte(0xcc) && writeBigEndian(value, 1);
+       if(value <= 0xffff) return writeByte(0xcd) && writeBigEndian(value, 2);
+       if(value <= 0xffffffff) return writeByte(0xce) && writeBigEndian(value, 4);
+       return writeByte(0xcf) && writeBigEndian(value, 8);
+    }
+
+    if(value >= -32) return writeByte(static_cast<unsigned char>(value));
+    if(value >= std::numeric_limits<std::int8_t>::min()) return writeByte(0xd0) && writeBigEndian(static_cast<std::uint64_t>(value), 1);
+    if(value >= std::numeric_limits<std::int16_t>::min()) return writeByte(0xd1) && writeBigEndian(static_cast<std::uint64_t>(value), 2);
+    if(value >= std::numeric_limits<std::int32_t>::min()) return writeByte(0xd2) && writeBigEndian(static_cast<std::uint64_t>(value), 4);
+    return writeByte(0xd3) && writeBigEndian(static_cast<std::uint64_t>(value), 8);
+}
+
+bool JsonSAXWriter::writeData(std::string_view data)
+{
+    if(!buffer->writeData(data))
+    {
+       _error = BufferEnding;
+       return false;
+    }
+
+    return true;
+}
+
+bool JsonSAXWriter::writeIndent(std::size_t level, bool newline)
+{
+    //indent holds '\n' followed by a run of indentation characters
+    std::size_t count = level * _style.indent;
+    std::size_t pos = (newline) ? 0 : 1;
+
+    do
+    {
+        const std::size_t size = std::min(count, indent.size() - 1);
+        if(!writeData(std::string_view(indent).substr(pos, size + 1 - pos))) return false;
+        count -= size;
+        pos = 1;
+    }
+    while(count > 0);
+
+    return true;
+}
+
+bool JsonSAXWriter::isInline() const { return (inlineLevel > 0 && stack.size() >= inlineLevel); }
+
+bool JsonSAXWriter::writeNextLine()
+{
+    if(!writeChar(',')) return false;
+    if(!beautiful) return true;
+    if(isInline()) return writeChar(' ');
+    return writeIndent(stack.size(), true);
+}
+
+bool JsonSAXWriter::checkCorrectValue()
+{
+    if(stack.empty())
+    {
+       _error = InvalidOperation;
+       return false;
+    }
+
+    return checkIsNotObject() && containerEnd();
+}
+
+bool JsonSAXWriter::containerEnd()
+{
+    if(stack.empty()) return true;
+
+    switch(stack.top())
+    {
+       case Сondition::ArrayNextValue: return writeNextLine();
+       case Сondition::ObjectKey: stack.top() = Сondition::ObjectNextPair;
+       break;
+       case Сondition::Array:
+       {
+          if(beautiful && !isInline() && !writeIndent(stack.size(), false)) return false;
+          stack.top() = Сondition::ArrayNextValue;
+       }
+       break;
+       default: break;
+    }
+
+    return true;
+}
+
+bool JsonSAXWriter::checkIsNotObject()
+{
+    if(!stack.empty() && (stack.top() == Сondition::Object || stack.top() == Сondition::ObjectNextPair))
+    {
+       _error = InvalidOperation;
+       return false;
+    }
+
+    return true;
+}
+
+bool JsonSAXWriter::checkIsObject()
+{
+    if(stack.empty() || (stack.top() != Сondition::Object && stack.top() != Сondition::ObjectNextPair))
+    {
+       _error = InvalidOperation;
+       return false;
+    }
+
+    return true;
+}
+
+bool JsonSAXWriter::writeStringData(std::string_view data)
+{
+    if(!stableStrings) return writeData(data);
+
+    if(!buffer->writeReference(data))
+    {
+       _error = BufferEnding;
+       return false;
+    }
+
+    return true;
+}
+
+static inline bool isEscaped(unsigned char c)
+{
+    return (c == '"' || c == '\\' || c == '/' || c < 32 || c == 127);
+}
+
+bool JsonSAXWriter::writeString(const std::string & string)
+{
+    JSON_STAT(const std::uint64_t started = statsClock());
+    if(!writeChar('"')) return false;
+
+    std::size_t begin = 0;
+    for(std::size_t i = 0; i < string.size(); i++)
+    {
+        const unsigned char c = string[i];
+        if(!isEscaped(c) || (canonical && (c == '/' || c == 127))) continue; //canonical: only '"', '\\' and control characters
+        JSON_STAT(_stats.escapes++);
+
+        if(i > begin && !writeStringData(std::string_view(string).substr(begin, i - begin))) return false;
+        begin = i + 1;
+
+        switch (c)
+        {
+           case '"': if(!writeData("\\\"")) return false;
+           break;
+           case '\\': if(!writeData("\\\\")) return false;
+           break;
+           case '/': if(!writeData("\\/")) return false;
+           break;
+           case '\b': if(!writeData("\\b")) return false;
+           break;
+           case '\f': if(!writeData("\\f")) return false;
+           break;
+           case '\n': if(!writeData("\\n")) return false;
+           break;
+           case '\r': if(!writeData("\\r")) return false;
+           break;
+           case '\t': if(!writeData("\\t")) return false;
+           break;
+           default:
+           {
+              static constexpr char hex[] = "0123456789abcdef";
+              const char escape[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+              if(!writeData(std::string_view(escape, sizeof(escape)))) return false;
+           }
+        }
+    }
+
+    if(string.size() > begin && !writeStringData(std::string_view(string).substr(begin))) return false;
+    if(!writeChar('"')) return false;
+
+    JSON_STAT(_stats.stringCycles += statsClock() - started);
+    return true;
+}
+
+//RFC 3629: no overlong forms, no surrogates, nothing above U+10FFFF
+static bool isUtf8(std::string_view string)
+{
+    for(std::size_t i = 0; i < string.size();)
+    {
+        const unsigned char c = string[i];
+
+        if(c < 0x80)
+        {
+           i++;
+           continue;
+        }
+
+        const std::size_t size = (c >= 0xc2 && c <= 0xdf) ? 2 : ((c & 0xf0) == 0xe0) ? 3 : (c >= 0xf0 && c <= 0xf4) ? 4 : 0;
+        if(size == 0 || string.size() - i < size) return false;
+
+        std::uint32_t code = c & (0x3f >> (size - 1));
+
+        for(std::size_t k = 1; k < size; k++)
+        {
+            const unsigned char next = string[i + k];
+            if((next & 0xc0) != 0x80) return false;
+            code = (code << 6) | (next & 0x3f);
+        }
+
+        if(size == 3 && (code < 0x800 || (code >= 0xd800 && code <= 0xdfff))) return false;
+        if(size == 4 && (code < 0x10000 || code > 0x10ffff)) return false;
+        i += size;
+    }
+
+    return true;
+}
+
+//UTF-8 byte order is code point order, UTF-16 order puts U+E000..U+FFFF (lead bytes 0xee, 0xef)
+//after the surrogate pairs of the characters above U+FFFF (lead bytes 0xf0..0xf4). The first
+//differing bytes of two valid strings are both lead bytes or both continuation bytes.
+static bool utf16Less(std::string_view first, std::string_view second)
+{
+    const std::size_t size = std::min(first.size(), second.size());
+    const std::size_t pos = std::mismatch(first.begin(), first.begin() + size, second.begin()).first - first.begin();
+    if(pos == size) return first.size() < second.size();
+
+    const auto weight = [](unsigned char c){ return (c == 0xee || c == 0xef) ? c + 0x100u : c; };
+    return weight(first[pos]) < weight(second[pos]);
+}
+
+//Maps are in code point order, the UTF-16 order differs only between U+E000..U+FFFF (lead bytes
+//0xee, 0xef) and the characters above U+FFFF (lead bytes 0xf0..0xf4). patch - keys merged into map.
+static bool utf16Reorder(const JsonValue::Object::Map & map, const JsonValue::Object::Map * patch = nullptr)
+{
+    bool high = false;
+    bool supplementary = false;
+
+    for(const JsonValue::Object::Map * keys : {&map, patch})
+    {
+        if(keys == nullptr) continue;
+
+        for(const auto & pair : *keys)
+        {
+            for(unsigned char c : pair.first)
+            {
+                high |= (c == 0xee || c == 0xef);
+                supplementary |= (c >= 0xf0);
+            }
+
+            if(high && supplementary) return true;
+        }
+    }
+
+    return false;
+}
+
+//ECMAScript Number::toString: the shortest digits, fixed notation for 1e-7 <= |value| < 1e21
+static std::size_t ecmaScriptNumber(double value, char * out)
+{
+    if(value == 0)
+    {
+       out[0] = '0'; //-0 too
+       return 1;
+    }
+
+    std::array<char, DOUBLE_TEXT> data;
+    auto [end, ec] = std::to_chars(data.data(), data.data() + data.size(), value, std::chars_format::scientific);
+    if(ec != std::errc()) return 0;
+
+    //d[.ddd]e±xx
+    const char * ptr = data.data();
+    char * pos = out;
+    if(*ptr == '-') *pos++ = *ptr++;
+
+    std::array<char, 17> digits;
+    std::size_t k = 0;
+    for(; *ptr != 'e'; ptr++){ if(*ptr != '.') digits[k++] = *ptr; }
+
+    int exponent = 0;
+    std::from_chars(ptr + ((ptr[1] == '+') ? 2 : 1), end, exponent);
+    const int n = exponent + 1; //value = digits * 10^(n - k)
+    const int count = static_cast<int>(k);
+
+    if(count <= n && n <= 21)
+    {
+       pos = std::copy_n(digits.data(), k, pos);
+       pos = std::fill_n(pos, n - count, '0');
+    }
+    else if(0 < n && n <= 21)
+    {
+       pos = std::copy_n(digits.data(), n, pos);
+       *pos++ = '.';
+       pos = std::copy_n(digits.data() + n, count - n, pos);
+    }
+    else if(-6 < n && n <= 0)
+    {
+       *pos++ = '0';
+       *pos++ = '.';
+       pos = std::fill_n(pos, -n, '0');
+       pos = std::copy_n(digits.data(), k, pos);
+    }
+    else
+    {
+       *pos++ = digits[0];
+
+       if(k > 1)
+       {
+          *pos++ = '.';
+          pos = std::copy_n(digits.data() + 1, k - 1, pos);
+       }
+
+       *pos++ = 'e';
+       *pos++ = (n - 1 < 0) ? '-' : '+';
+       pos = std::to_chars(pos, pos + 4, std::abs(n - 1)).ptr;
+    }
+
+    return static_cast<std::size_t>(pos - out);
+}
+
+bool JsonSAXWriter::writeCanonicalNumber(double value)
+{
+    std::array<char, 32> data;
+    JSON_STAT(const std::uint64_t begin = statsClock());
+    const std::size_t size = ecmaScriptNumber(value, data.data());
+    JSON_STAT(_stats.numberCycles += statsClock() - begin);
+
+    if(size == 0)
+    {
+       _error = ErrorConvDouble;
+       return false;
+    }
+
+    return writeData(std::string_view(data.data(), size));
+}
+
+void JsonSAXWriter::setError(const std::string & error){ _error = error; }
+
+void JsonSAXWriter::setStableStrings(bool stable){ stableStrings = stable; }
+
+bool JsonSAXWriter::isCanonical() const { return canonical; }
+
+bool JsonSAXWriter::FragmentBegin()
+{
+    if(!checkBuffer()) return false;
+
+    if(format != JsonFormat::Text || canonical)
+    {
+       _error = InvalidOperation;
+       return false;
+    }
+
+    if(!checkIsNotObject() || !containerEnd()) return false;
+    stack.push(Сondition::Fragment);
+    return true;
+}
+
+bool JsonSAXWriter::FragmentData(std::string_view data){ return checkBuffer() && writeData(data); }
+
+bool JsonSAXWriter::FragmentEnd()
+{
+    if(stack.empty() || stack.top() != Сondition::Fragment)
+    {
+       _error = InvalidOperation;
+       return false;
+    }
+
+    stack.pop();
+    return true;
+}
+
+JsonSAXWriter::JsonSAXWriter(){ setStyle(Style()); }
+
+std::string JsonSAXWriter::error() const { return std::move(_error); }
+const JsonStats & JsonSAXWriter::stats() const { return _stats; }
+void JsonSAXWriter::resetStats(){ _stats = JsonStats(); }
+
+void JsonSAXWriter::setStyle(const Style & style)
+{
+    _style = style;
+    indent.assign(1, '\n');
+    indent.append(std::max<std::size_t>(IndentRun, style.indent), (style.tabs) ? '\t' : ' ');
+}
+
+JsonSAXWriter::Style JsonSAXWriter::style() const { return _style; }
+
+void JsonSAXWriter::setBuffer(JsonBufferWriter * buffer, bool beautiful)
+{
+    while(!stack.empty()) stack.pop();
+    while(!frames.empty()) frames.pop();
+    pending.clear();
+    pendingDepth = 0;
+    inlineLevel = 0;
+    this->buffer = buffer;
+    this->beautiful = beautiful;
+    format = JsonFormat::Text;
+    canonical = false;
+}
+
+void JsonSAXWriter::setBuffer(JsonBufferWriter * buffer, JsonFormat format)
+{
+    setBuffer(buffer, false);
+    canonical = (format == JsonFormat::Canonical);
+    this->format = (format == JsonFormat::JSON5 || canonical) ? JsonFormat::Text : format; //JSON is JSON5, canonical JSON is JSON
+}
+
+bool JsonSAXWriter::ObjectBegin(std::size_t size)
+{
+    if(!checkBuffer()) return false;
+    JSON_STAT(_stats.objects++; _stats.maxDepth = std::max<std::uint64_t>(_stats.maxDepth, ((format == JsonFormat::Text) ? stack.size() : frames.size()) + 1));
+    if(format != JsonFormat::Text) return binaryItem(false, true) && binaryBegin(true, size);
+    if(!checkIsNotObject() || !containerEnd() || !writeChar('{')) return false;
+    if(beautiful && !isInline() && !writeChar('\n')) return false;
+    stack.push(Сondition::Object);
+    if(canonical && canonicalKeys.size() < stack.size()) canonicalKeys.resize(stack.size());
+    return true;
+}
+
+bool JsonSAXWriter::ObjectKey(const std::string & key)
+{
+    if(!checkBuffer()) return false;
+    JSON_STAT(_stats.keys++; _stats.stringBytes += key.size());
+    if(format != JsonFormat::Text) return binaryItem(true, false) && binaryString(key);
+    if(!checkIsObject()) return false;
+
+    if(canonical)
+    {
+       if(stack.top() == Сondition::ObjectNextPair && !utf16Less(canonicalKeys[stack.size() - 1], key))
+       {
+          _error = CanonicalKeyOrder;
+          return false;
+       }
+
+       if(!isUtf8(key))
+       {
+          _error = CanonicalString;
+          return false;
+       }
+
+       canonicalKeys[stack.size() - 1] = key;
+    }
+
+    if(stack.top() == Сondition::ObjectNextPair)
+    {
+       if(!writeNextLine()) return false;
+    }
+    else if(beautiful && !isInline() && !writeIndent(stack.size(), false)) return false;
+
+    if(!writeString(key) || !writeChar(':')) return false;
+    stack.top() = Сondition::ObjectKey;
+    return true;
+}
+
+bool JsonSAXWriter::ObjectEnd()
+{
+    if(!checkBuffer()) return false;
+    if(format != JsonFormat::Text) return binaryEnd(true);
+    if(!checkIsObject()) return false;
+    if(beautiful && !isInline() && !writeIndent(stack.size() - 1, true)) return false;
+    if(!writeChar('}')) return false;
+    stack.pop();
+    return true;
+}
+
+bool JsonSAXWriter::ArrayBegin(std::size_t size, bool compact)
+{
+    if(!checkBuffer()) return false;
+    JSON_STAT(_stats.arrays++; _stats.maxDepth = std::max<std::uint64_t>(_stats.maxDepth, ((format == JsonFormat::Text) ? stack.size() : frames.size()) + 1));
+    if(format != JsonFormat::Text) return binaryItem(false, true) && binaryBegin(false, size);
+    if(!checkIsNotObject() || !containerEnd() || !writeChar('[')) return false;
+    stack.push(Сondition::Array);
+    if(beautiful && compact && inlineLevel == 0) inlineLevel = stack.size();
+    if(beautiful && !isInline() && !writeChar('\n')) return false;
+    return true;
+}
+
+bool JsonSAXWriter::ArrayEnd()
+{
+    if(!checkBuffer()) return false;
+    if(format != JsonFormat::Text) return binaryEnd(false);
+    if(stack.empty() || (stack.top() != Сondition::Array && stack.top() != Сondition::ArrayNextValue))
+    {
+       _error = InvalidOperation;
+       return false;
+    }
+
+    const bool compact = isInline();
+    stack.pop();
+    if(inlineLevel > stack.size()) inlineLevel = 0;
+    if(beautiful && !compact && !writeIndent(stack.size(), true)) return false;
+    if(!writeChar(']')) return false;
+    return true;
+}
+
+bool JsonSAXWriter::Value(const std::string & value)
+{
+    if(!checkBuffer()) return false;
+    JSON_STAT(_stats.strings++; _stats.stringBytes += value.size());
+    if(format != JsonFormat::Text) return binaryItem(false, false) && binaryString(value);
+
+    if(canonical && !isUtf8(value))
+    {
+       _error = CanonicalString;
+       return false;
+    }
+
+    if(!checkCorrectValue()) return false;
+    if(!writeString(value)) return false;
+    return true;
+}
+
+bool JsonSAXWriter::Value(double value)
+{
+    if(!checkBuffer()) return false;
+    JSON_STAT(_stats.doubles++);
+
+    if(format != JsonFormat::Text)
+    {
+       if(!binaryItem(false, false)) return false;
+       return writeByte((format == JsonFormat::CBOR) ? 0xfb : 0xcb) && writeBigEndian(std::bit_cast<std::uint64_t>(value), 8);
+    }
+
+    if(canonical && !std::isfinite(value))
+    {
+       _error = CanonicalNumber;
+       return false;
+    }
+
+    if(!checkCorrectValue()) return false;
+    if(canonical) return writeCanonicalNumber(value);
+    if(!std::isfinite(value)) return writeData("null"); //NaN and infinities have no json text
+
+    std::array<char, DOUBLE_TEXT> data;
+    JSON_STAT(const std::uint64_t begin = statsClock());
+    auto [ptr, ec] = std::to_chars(data.data(), data.data() + data.size(), value);
+    JSON_STAT(_stats.numberCycles += statsClock() - begin);
+
+    if(ec != std::errc())
+    {
+       _error = ErrorConvDouble;
+       return false;
+    }
+
+    return writeData(std::string_view(data.data(), ptr));
+}
+
+bool JsonSAXWriter::Value(long long value)
+{
+    if(!checkBuffer()) return false;
+    JSON_STAT(_stats.integers++);
+    if(format != JsonFormat::Text) return binaryItem(false, false) && binaryInteger(value);
+    if(!checkCorrectValue()) return false;
+
+    //canonical numbers are doubles, integers up to 2^53 have the same text
+    constexpr long long Exact = 1LL << 53;
+    if(canonical && (value > Exact || value < -Exact)) return writeCanonicalNumber(static_cast<double>(value));
+
+    std::array<char, 20> data;
+    JSON_STAT(const std::uint64_t begin = statsClock());
+    auto [ptr, ec] = std::to_chars(data.data(), data.data() + data.size(), value);
+    JSON_STAT(_stats.numberCycles += statsClock() - begin);
+
+    if(ec != std::errc())
+    {
+       _error = ErrorConvLongLong;
+       return false;
+    }
+
+    return writeData(std::string_view(data.data(), ptr));
+}
+
+static const std::string_view S_True("true"), S_False("false"), S_Null("null");
+
+bool JsonSAXWriter::Value(bool value)
+{
+    if(!checkBuffer()) return false;
+    JSON_STAT(_stats.bools++);
+    if(format == JsonFormat::MessagePack) return binaryItem(false, false) && writeByte((value) ? 0xc3 : 0xc2);
+    if(format == JsonFormat::CBOR) return binaryItem(false, false) && writeByte((value) ? 0xf5 : 0xf4);
+    if(!checkCorrectValue()) return false;
+    return writeData((value) ? S_True : S_False);
+}
+
+bool JsonSAXWriter::Null()
+{
+    if(!checkBuffer()) return false;
+    JSON_STAT(_stats.nulls++);
+    if(format == JsonFormat::MessagePack) return binaryItem(false, false) && writeByte(0xc0);
+    if(format == JsonFormat::CBOR) return binaryItem(false, false) && writeByte(0xf6);
+    if(!checkCorrectValue()) return false;
+    return writeData(S_Null);
+}
+
+bool JsonSAXWriter::Raw(std::string_view json)
+{
+    if(!checkBuffer()) return false;
+
+    //canonical text of a raw value is not known without parsing it
+    if(format != JsonFormat::Text || canonical || json.empty())
+    {
+       _error = InvalidOperation;
+       return false;
+    }
+
+    if(!checkCorrectValue()) return false;
+    return writeStringData(json);
+}
+
+//-----------------------------------------------------------------------------
+
+bool JsonWriter::writeValue(const JsonValue & value)
+{
+    switch (value.type())
+    {
+       case JsonType::String: if(!Value(std::get<std::string>(*value.value))) return false;
+       break;
+       case JsonType::Double: if(!Value(value.getDouble())) return false;
+       break;
+       case JsonType::LongLong: if(!Value(value.getLongLong())) return false;
+       break;
+       case JsonType::Bool: if(!Value(value.getBool())) return false;
+       break;
+       case JsonType::Null: if(!Null()) return false;
+       break;
+       case JsonType::Raw: if(!Raw(std::get<JsonValue::Raw>(*value.value).json)) return false;
+       break;
+       default:
+       {
+          setError("Invalid json value is empty type");
+          return false;
+       }
+       break;
+    }
+
+    return true;
+}
+
+bool JsonWriter::Recorder::write(unsigned char ch)
+{
+    if(active) text.push_back(static_cast<char>(ch));
+    return target->write(ch);
+}
+
+bool JsonWriter::Recorder::writeData(std::string_view data)
+{
+    if(active) text.append(data);
+    return target->writeData(data);
+}
+
+bool JsonWriter::Recorder::writeReference(std::string_view data)
+{
+    if(active) text.append(data);
+    return target->writeReference(data);
+}
+
+std::size_t JsonWriter::Recorder::writeCount(){ return target->writeCount(); }
+
+JsonWriter::JsonWriter(){ setStableStrings(true); }
+
+bool JsonWriter::isAncestor(const void * container) const
+{
+    const std::size_t linear = std::min(frames.size(), LinearAncestors);
+    for(std::size_t i = 0; i < linear; i++){ if(frames[i].container() == container) return true; }
+    return (frames.size() > LinearAncestors && ancestors.contains(container));
+}
+
+bool JsonWriter::enterContainer(const JsonValue & value)
+{
+    Frame frame;
+    std::size_t size;
+    JsonValue::Cache * cache;
+
+    if(value.value->index() == static_cast<std::size_t>(JsonType::Object))
+    {
+       const JsonValue::Object & object = std::get<JsonValue::Object>(*value.value);
+       frame.map = object.map.get();
+       frame.pos = frame.map->begin();
+       size = frame.map->size();
+       cache = &object.slot->cache;
+    }
+    else
+    {
+       const JsonValue::Array & array = std::get<JsonValue::Array>(*value.value);
+       frame.array = array.array.get();
+       size = frame.array->size();
+       cache = &array.slot->cache;
+    }
+
+    if(checkCycles && isAncestor(frame.container()))
+    {
+       //the text depends on where the cycle was entered
+       if(caching){ for(Frame & open : frames) open.cache = nullptr; }
+       return Null();
+    }
+
+    if(caching)
+    {
+       layout.level = frames.size() + 1;
+       frame.spliced = spliced.size();
+
+       const JsonValue::Fragment * cached = cache->load(std::memory_order_acquire);
+
+       if(cached != nullptr && cached->level == layout.level && cached->beautiful == layout.beautiful &&
+          cached->indent == layout.indent && cached->tabs == layout.tabs && cached->compact == layout.compact)
+       {
+          if(!FragmentBegin()) return false;
+          frame.fragment = cached;
+          frame.start = recorder.text.size();
+          if(checkCycles && frames.size() >= LinearAncestors) ancestors.insert(frame.container());
+          JSON_STAT(_stats.allocations += (frames.size() == frames.capacity()));
+          frames.push_back(frame);
+          return true;
+       }
+
+       frame.cache = cache;
+    }
+
+    if(frame.map != nullptr)
+    {
+       if(!ObjectBegin(size)) return false;
+
+       //canonical keys are in UTF-16 order, the map is walked through sorted pointers only when it differs
+       if(isCanonical() && utf16Reorder(*frame.map))
+       {
+          frame.order = ordered.size();
+          for(const auto & pair : *frame.map) ordered.push_back(&pair);
+          std::sort(ordered.begin() + frame.order, ordered.end(), [](const auto * first, const auto * second){ return utf16Less(first->first, second->first); });
+       }
+    }
+    else
+    {
+       bool compact = style().compactArrays;
+
+       for(std::size_t i = 0; compact && i < size; i++)
+       {
+           const JsonType type = (*frame.array)[i].type();
+           compact = (type != JsonType::Object && type != JsonType::Array);
+       }
+
+       if(!ArrayBegin(size, compact)) return false;
+    }
+
+    if(caching) frame.start = recorder.text.rfind((frame.map != nullptr) ? '{' : '[');
+    if(checkCycles && frames.size() >= LinearAncestors) ancestors.insert(frame.container());
+    JSON_STAT(_stats.allocations += (frames.size() == frames.capacity()));
+    frames.push_back(frame);
+    return true;
+}
+
+//base of the patched objects that are not in json
+static const JsonValue::Object::Map emptyMap;
+
+bool JsonWriter::enterMerged(const JsonValue * base, const JsonValue & patch)
+{
+    Frame frame;
+    const JsonValue::Object * object = (base != nullptr) ? std::get_if<JsonValue::Object>(base->value.get()) : nullptr;
+    frame.map = (object != nullptr) ? object->map.get() : &emptyMap;
+    frame.pos = frame.map->begin();
+    frame.patch = std::get<JsonValue::Object>(*patch.value).map.get();
+    frame.patchPos = frame.patch->begin();
+
+    if(checkCycles && isAncestor(frame.container())) return Null();
+
+    //definite-length binary containers need the merged size up front
+    std::size_t size = frame.map->size();
+
+    for(const auto & [key, value] : *frame.patch)
+    {
+        const bool removed = (value.type() == JsonType::Null);
+        if(frame.map->contains(key)) size -= removed;
+        else size += !removed;
+    }
+
+    if(!ObjectBegin(size)) return false;
+
+    //canonical keys in UTF-16 order: the pairs left in the base and the pairs of the patch are sorted together
+    if(isCanonical() && utf16Reorder(*frame.map, frame.patch))
+    {
+       frame.order = ordered.size();
+       for(const auto & pair : *frame.map){ if(!frame.patch->contains(pair.first)) ordered.push_back(&pair); }
+       for(const auto & pair : *frame.patch){ if(pair.second.type() != JsonType::Null) ordered.push_back(&pair); }
+       std::sort(ordered.begin() + frame.order, ordered.end(), [](const auto * first, const auto * second){ return utf16Less(first->first, second->first); });
+    }
+
+    if(checkCycles && frames.size() >= LinearAncestors) ancestors.insert(frame.container());
+    JSON_STAT(_stats.allocations += (frames.size() == frames.capacity()));
+    frames.push_back(frame);
+    return true;
+}
+
+bool JsonWriter::writeFragment(Frame & frame, std::size_t end)
+{
+    //cached text is already part of the fragments of the enclosing containers
+    recorder.active = false;
+    const bool ret = FragmentData(std::string_view(frame.fragment->text).substr(frame.piece, end - frame.piece));
+    recorder.active = true;
+    frame.piece = end;
+    return ret;
+}
+
+void JsonWriter::storeFragment(const Frame & frame)
+{
+    const std::size_t end = recorder.text.size();
+
+    if(frame.cache != nullptr)
+    {
+       auto fragment = std::make_unique<JsonValue::Fragment>(layout);
+       JSON_STAT(_stats.allocations++);
+       fragment->level = frames.size() + 1;
+       fragment->text.reserve(end - frame.start);
+       std::size_t pos = frame.start;
+
+       for(std::size_t i = frame.spliced; i < spliced.size(); i++)
+       {
+           fragment->text.append(recorder.text, pos, spliced[i].first - pos);
+           fragment->holes.push_back(fragment->text.size());
+           pos = spliced[i].second;
+       }
+
+       fragment->text.append(recorder.text, pos, end - pos);
+       delete frame.cache->exchange(fragment.release(), std::memory_order_acq_rel);
+    }
+
+    //the enclosing container leaves this text out of its own fragment
+    spliced.resize(frame.spliced);
+    spliced.emplace_back(frame.start, end);
+}
+
+bool JsonWriter::writeTree(const JsonValue & json)
+{
+    if(json.type() != JsonType::Object && json.type() != JsonType::Array) return false;
+
+    frames.clear();
+    ancestors.clear();
+    ordered.clear();
+    if(!enterContainer(json)) return false;
+    return writeFrames();
+}
+
+bool JsonWriter::writeFrames()
+{
+    //a value of a merge patch, objects are merged into the base value
+    auto writeChange = [this](const JsonValue * base, const JsonValue & change)
+    {
+        const JsonType type = change.type();
+        if(type == JsonType::Object) return enterMerged(base, change);
+        if(type == JsonType::Array) return enterContainer(change);
+        return writeValue(change);
+    };
+
+    while(!frames.empty())
+    {
+       Frame & frame = frames.back();
+       const JsonValue * value;
+
+       if(frame.fragment != nullptr)
+       {
+          //the next child container fills the next hole
+          value = nullptr;
+
+          if(frame.map != nullptr)
+          {
+             for(; frame.pos != frame.map->end() && value == nullptr; ++frame.pos)
+             {
+                 const JsonType type = frame.pos->second.type();
+                 if(type == JsonType::Object || type == JsonType::Array) value = &frame.pos->second;
+             }
+          }
+          else
+          {
+             for(; frame.index < frame.array->size() && value == nullptr; frame.index++)
+             {
+                 const JsonType type = (*frame.array)[frame.index].type();
+                 if(type == JsonType::Object || type == JsonType::Array) value = &(*frame.array)[frame.index];
+             }
+          }
+
+          if(value == nullptr || frame.hole == frame.fragment->holes.size())
+          {
+             if(!writeFragment(frame, frame.fragment->text.size())) return false;
+             if(checkCycles && frames.size() > LinearAncestors) ancestors.erase(frame.container());
+             const Frame done = frame;
+             frames.pop_back();
+             if(!FragmentEnd()) return false;
+             storeFragment(done);
+             continue;
+          }
+
+          if(!writeFragment(frame, frame.fragment->holes[frame.hole++]) || !enterContainer(*value)) return false;
+          continue;
+       }
+
+       if(frame.map != nullptr)
+       {
+          const bool sorted = (frame.order != Unordered);
+
+          //keys of the patch in front of the next base key replace, remove or add values
+          if(!sorted && frame.patch != nullptr && frame.patchPos != frame.patch->end() &&
+             (frame.pos == frame.map->end() || frame.patchPos->first <= frame.pos->first))
+          {
+             const std::string & key = frame.patchPos->first;
+             const JsonValue & change = frame.patchPos->second;
+             const JsonValue * base = nullptr;
+             ++frame.patchPos;
+
+             if(frame.pos != frame.map->end() && frame.pos->first == key)
+             {
+                base = &frame.pos->second;
+                ++frame.pos;
+             }
+
+             if(change.type() == JsonType::Null) continue;
+             if(!ObjectKey(key) || !writeChange(base, change)) return false;
+             continue;
+          }
+
+          //the sorted pairs of an open map are the last ones in ordered
+          if(sorted ? frame.order + frame.index == ordered.size() : frame.pos == frame.map->end())
+          {
+             if(checkCycles && frames.size() > LinearAncestors) ancestors.erase(frame.container());
+             const Frame done = frame;
+             frames.pop_back();
+             if(sorted) ordered.resize(done.order);
+             if(!ObjectEnd()) return false;
+             if(caching) storeFragment(done);
+             continue;
+          }
+
+          const auto & pair = sorted ? *ordered[frame.order + frame.index++] : *frame.pos++;
+          if(!ObjectKey(pair.first)) return false;
+
+          //sorted merge: a pair of the patch replaces or adds a value
+          if(sorted && frame.patch != nullptr)
+          {
+             auto change = frame.patch->find(pair.first);
+
+             if(change != frame.patch->end() && &*change == &pair)
+             {
+                auto base = frame.map->find(pair.first);
+                if(!writeChange((base != frame.map->end()) ? &base->second : nullptr, pair.second)) return false;
+                continue;
+             }
+          }
+
+          value = &pair.second;
+       }
+       else
+       {
+          if(frame.index == frame.array->size())
+          {
+             if(checkCycles && frames.size() > LinearAncestors) ancestors.erase(frame.container());
+             const Frame done = frame;
+             frames.pop_back();
+             if(!ArrayEnd()) return false;
+             if(caching) storeFragment(done);
+             continue;
+          }
+
+          value = &(*frame.array)[frame.index++];
+       }
+
+       const JsonType type = value->type();
+
+       if(type == JsonType::Object || type == JsonType::Array)
+       {
+          if(!enterContainer(*value)) return false;
+       }
+       else if(!writeValue(*value)) return false;
+    }
+
+    return true;
+}
+
+void JsonWriter::setCycleCheck(bool enabled){ checkCycles = enabled; }
+
+void JsonWriter::setCache(bool enabled){ caching = enabled; }
+
+void JsonWriter::setMemoryResource(std::pmr::memory_resource * resource)
+{
+    if(resource == nullptr) resource = std::pmr::get_default_resource();
+
+    //polymorphic allocators do not propagate on assignment, the containers are made again
+    std::destroy_at(&frames);
+    std::construct_at(&frames, resource);
+    std::destroy_at(&ancestors);
+    std::construct_at(&ancestors, resource);
+    std::destroy_at(&spliced);
+    std::construct_at(&spliced, resource);
+    std::destroy_at(&ordered);
+    std::construct_at(&ordered, resource);
+}
+
+static std::size_t escapedSize(const std::string & string)
+{
+    std::size_t size = string.size();
+
+    for(unsigned char c : string)
+    {
+        switch(c)
+        {
+           case '"':
+           case '\\':
+           case '/':
+           case '\b':
+           case '\f':
+           case '\n':
+           case '\r':
+           case '\t': size++;
+           break;
+           default: if(c < 32 || c == 127) size += 5;
+        }
+    }
+
+    return size;
+}
+
+static std::size_t scalarSize(const JsonValue::Value & value)
+{
+    switch(static_cast<JsonType>(value.index()))
+    {
+       case JsonType::String: return escapedSize(std::get<std::string>(value)) + 2;
+       case JsonType::Double:
+       {
+          if(!std::isfinite(std::get<double>(value))) return 4;
+          std::array<char, DOUBLE_TEXT> data;
+          auto [ptr, ec] = std::to_chars(data.data(), data.data() + data.size(), std::get<double>(value));
+          return (ec == std::errc()) ? static_cast<std::size_t>(ptr - data.data()) : 0;
+       }
+       case JsonType::LongLong:
+       {
+          std::array<char, 20> data;
+          auto [ptr, ec] = std::to_chars(data.data(), data.data() + data.size(), std::get<long long>(value));
+          return (ec == std::errc()) ? static_cast<std::size_t>(ptr - data.data()) : 0;
+       }
+       case JsonType::Bool: return (std::get<bool>(value)) ? 4 : 5;
+       case JsonType::Null: return 4;
+       case JsonType::Raw: return std::get<JsonValue::Raw>(value).json.size();
+       default: return 0;
+    }
+}
+
+std::size_t JsonWriter::size(const JsonValue & json, bool beautiful)
+{
+    if(json.type() != JsonType::Object && json.type() != JsonType::Array) return 0;
+
+    const Style current = style();
+    const std::size_t width = current.indent;
+    std::size_t total = 0;
+
+    auto enter = [&](const JsonValue & value)
+    {
+        Frame frame;
+        std::size_t count;
+
+        if(value.value->index() == static_cast<std::size_t>(JsonType::Object))
+        {
+           frame.map = std::get<JsonValue::Object>(*value.value).map.get();
+           frame.pos = frame.map->begin();
+           count = frame.map->size();
+        }
+        else
+        {
+           frame.array = std::get<JsonValue::Array>(*value.value).array.get();
+           count = frame.array->size();
+        }
+
+        if(checkCycles && isAncestor(frame.container()))
+        {
+           total += 4; //null
+           return;
+        }
+
+        if(frame.map != nullptr) total += 3 * count; //key quotes and ':'
+
+        const std::size_t separators = (count > 0) ? count - 1 : 0;
+        total += 2 + separators; //brackets and commas
+
+        if(beautiful)
+        {
+           bool compact = (frame.array != nullptr && current.compactArrays);
+
+           for(std::size_t i = 0; compact && i < count; i++)
+           {
+               const JsonType type = (*frame.array)[i].type();
+               compact = (type != JsonType::Object && type != JsonType::Array);
+           }
+
+           const std::size_t level = frames.size() + 1;
+           if(compact) total += separators; //space after comma
+           else total += 2 + separators + count * level * width + (level - 1) * width; //line breaks and indentation
+        }
+
+        if(checkCycles && frames.size() >= LinearAncestors) ancestors.insert(frame.container());
+        frames.push_back(frame);
+    };
+
+    frames.clear();
+    ancestors.clear();
+    enter(json);
+
+    while(!frames.empty())
+    {
+       Frame & frame = frames.back();
+       const JsonValue * value;
+
+       if(frame.map != nullptr)
+       {
+          if(frame.pos == frame.map->end())
+          {
+             if(checkCycles && frames.size() > LinearAncestors) ancestors.erase(frame.container());
+             frames.pop_back();
+             continue;
+          }
+
+          total += escapedSize(frame.pos->first);
+          value = &frame.pos->second;
+          ++frame.pos;
+       }
+       else
+       {
+          if(frame.index == frame.array->size())
+          {
+             if(checkCycles && frames.size() > LinearAncestors) ancestors.erase(frame.container());
+             frames.pop_back();
+             continue;
+          }
+
+          value = &(*frame.array)[frame.index++];
+       }
+
+       const JsonType type = value->type();
+       if(type == JsonType::Object || type == JsonType::Array) enter(*value);
+       else total += scalarSize(*value->value);
+    }
+
+    return total;
+}
+
+bool JsonWriter::write(JsonBufferWriter & buffer, const JsonValue & json, bool beautiful)
+{
+    if(!caching)
+    {
+       setBuffer(&buffer, beautiful);
+       return writeTree(buffer, json);
+    }
+
+    //the style does not change compact text
+    const Style current = (beautiful) ? style() : Style{0, false, false};
+    layout.beautiful = beautiful;
+    layout.indent = current.indent;
+    layout.tabs = current.tabs;
+    layout.compact = current.compactArrays;
+    recorder.target = &buffer;
+    recorder.text.clear();
+    spliced.clear();
+    setBuffer(&recorder, beautiful);
+    return writeTree(buffer, json);
+}
+
+bool JsonWriter::write(std::string & string, const JsonValue & json, bool beautiful)
+{
+    JsonStringBufferWriter buffer;
+    if(!write(buffer, json, beautiful)) return false;
+    string = std::move(const_cast<std::string &>(buffer.result()));
+    return true;
+}
+
+std::string JsonWriter::write(const JsonValue & json, bool beautiful)
+{
+    std::string ret;
+    write(ret, json, beautiful);
+    return ret;
+}
+
+bool JsonWriter::writeToFile(const std::string & fileName, const JsonValue & json, bool beautiful)
+{
+    JsonFileBufferWriter buffer;
+    if(!buffer.open(fileName) || !write(buffer, json, beautiful)) return false;
+    return true;
+}
+
+bool JsonWriter::write(JsonBufferWriter & buffer, const JsonValue & json, JsonFormat format)
+{
+    //the cache holds text of the bool overloads, other formats are written in full
+    const bool cached = caching;
+    caching = false;
+    setBuffer(&buffer, format);
+    const bool ret = writeTree(buffer, json);
+    caching = cached;
+    return ret;
+}
+
+bool JsonWriter::writeTree([[maybe_unused]] JsonBufferWriter & buffer, const JsonValue & json)
+{
+    JSON_STAT(const std::size_t written = buffer.writeCount());
+    bool ret;
+    JSON_TIMED(_stats.totalCycles, ret = writeTree(json));
+    JSON_STAT(_stats.bytes += buffer.writeCount() - written);
+    return ret;
+}
+
+bool JsonWriter::writeMergedTree([[maybe_unused]] JsonBufferWriter & buffer, const JsonValue & json, const JsonValue & patch)
+{
+    //the buffer is not recorded, cached fragments are neither spliced in nor stored
+    const bool cached = caching;
+    caching = false;
+    bool ret;
+
+    if(patch.type() != JsonType::Object) ret = writeTree(buffer, patch);
+    else
+    {
+       JSON_STAT(const std::size_t written = buffer.writeCount());
+       frames.clear();
+       ancestors.clear();
+       ordered.clear();
+       JSON_TIMED(_stats.totalCycles, ret = enterMerged(&json, patch) && writeFrames());
+       JSON_STAT(_stats.bytes += buffer.writeCount() - written);
+    }
+
+    caching = cached;
+    return ret;
+}
+
+bool JsonWriter::writeMerged(JsonBufferWriter & buffer, const JsonValue & json, const JsonValue & patch, bool beautiful)
+{
+    setBuffer(&buffer, beautiful);
+    return writeMergedTree(buffer, json, patch);
+}
+
+bool JsonWriter::writeMerged(std::string & string, const JsonValue & json, const JsonValue & patch, bool beautiful)
+{
+    JsonStringBufferWriter buffer;
+    if(!writeMerged(buffer, json, patch, beautiful)) return false;
+    string = std::move(const_cast<std::string &>(buffer.result()));
+    return true;
+}
+
+bool JsonWriter::writeMerged(JsonBufferWriter & buffer, const JsonValue & json, const JsonValue & patch, JsonFormat format)
+{
+    setBuffer(&buffer, format);
+    return writeMergedTree(buffer, json, patch);
+}
+
+bool JsonWriter::write(std::string & string, const JsonValue & json, JsonFormat format)
+{
+    JsonStringBufferWriter buffer;
+    if(!write(buffer, json, format)) return false;
+    string = std::move(const_cast<std::string &>(buffer.result()));
+    return true;
+}
+
+std::string JsonWriter::write(const JsonValue & json, JsonFormat format)
+{
+    std::string ret;
+    write(ret, json, format);
+    return ret;
+}
+
+bool JsonWriter::writeToFile(const std::string & fileName, const JsonValue & json, JsonFormat format)
+{
+    JsonFileBufferWriter buffer;
+    if(!buffer.open(fileName) || !write(buffer, json, format)) return false;
+    return true;
+}
+
+//----------------------------------------------------------------
+
+static const char * const InvalidPatchMsg = "Patch is not an array of operations";
+static const char * const InvalidPatchOperationMsg = "Invalid patch operation, index: ";
+static const char * const InvalidPointerMsg = "Invalid JSON pointer, index: ";
+static const char * const PathNotFoundMsg = "Patch path not found, index: ";
+static const char * const MoveIntoChildMsg = "Patch moves a value into its own child, index: ";
+static const char * const TestFailedMsg = "Patch test failed, index: ";
+
+static const JsonValue::Object * objectOf(const JsonValue & value){ return std::get_if<JsonValue::Object>(&value.getValue()); }
+static const JsonValue::Array * arrayOf(const JsonValue & value){ return std::get_if<JsonValue::Array>(&value.getValue()); }
+
+//2^63 is out of the range of long long, integral doubles below it convert exactly
+static bool sameNumber(double first, long long second)
+{
+    return first >= -0x1p63 && first < 0x1p63 && std::trunc(first) == first && static_cast<long long>(first) == second;
+}
+
+JsonPatch::JsonPatch(){}
+
+void JsonPatch::setAtomic(bool enabled){ atomic = enabled; }
+
+std::string JsonPatch::error() const { return _error; }
+
+bool JsonPatch::fail(const char * msg, std::size_t index)
+{
+    _error = msg + std::to_string(index);
+    return false;
+}
+
+bool JsonPatch::parsePointer(const std::string & pointer, std::vector<std::string> & tokens)
+{
+    tokens.clear();
+    if(pointer.empty()) return true;
+    if(pointer[0] != '/') return false;
+
+    for(std::size_t pos = 1;;)
+    {
+        const std::size_t end = std::min(pointer.find('/', pos), pointer.size());
+        std::string & token = tokens.emplace_back();
+
+        for(std::size_t i = pos; i < end; i++)
+        {
+            if(pointer[i] != '~')
+            {
+               token.push_back(pointer[i]);
+               continue;
+            }
+
+            if(i + 1 == end || (pointer[i + 1] != '0' && pointer[i + 1] != '1')) return false;
+            token.push_back((pointer[++i] == '0') ? '~' : '/');
+        }
+
+        if(end == pointer.size()) return true;
+        pos = end + 1;
+    }
+}
+
+bool JsonPatch::parseIndex(const std::string & token, std::size_t size, std::size_t & index)
+{
+    //no sign and no leading zeros
+    if(token.empty() || (token[0] == '0' && token.size() > 1)) return false;
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), index);
+    return ec == std::errc() && ptr == token.data() + token.size() && index <= size;
+}
+
+JsonValue * JsonPatch::resolveParent(JsonValue & document, const std::vector<std::string> & tokens)
+{
+    const std::size_t depth = tokens.size() - 1;
+    if(steps.empty()) steps.push_back({&document, {}});
+
+    //steps kept from the previous operation were unshared by its edits, only their children changed
+    std::size_t same = 1;
+    while(same < steps.size() && same <= depth && steps[same].token == tokens[same - 1]) same++;
+    steps.resize(same);
+
+    for(std::size_t i = same - 1; i < depth; i++)
+    {
+        JsonValue & parent = *steps.back().value;
+        const std::string & token = tokens[i];
+        JsonValue * child;
+
+        if(const JsonValue::Object * object = objectOf(parent))
+        {
+           if(!object->contains(token)) return nullptr;
+           child = &parent.edit(token);
+        }
+        else if(const JsonValue::Array * array = arrayOf(parent))
+        {
+           std::size_t index;
+           if(!parseIndex(token, array->count(), index) || index == array->count()) return nullptr;
+           child = &parent.edit(index);
+        }
+        else return nullptr;
+
+        steps.push_back({child, token});
+    }
+
+    return steps.back().value;
+}
+
+const JsonValue * JsonPatch::find(const JsonValue & document, const std::vector<std::string> & tokens) const
+{
+    //the steps are the values a walk from the document reaches
+    std::size_t same = 1;
+    while(same < steps.size() && same <= tokens.size() && steps[same].token == tokens[same - 1]) same++;
+    const JsonValue * node = (steps.empty()) ? &document : steps[same - 1].value;
+
+    for(std::size_t i = same - 1; i < tokens.size(); i++)
+    {
+        if(const JsonValue::Object * object = objectOf(*node))
+        {
+           auto pos = object->getMap().find(tokens[i]);
+           if(pos == object->getMap().end()) return nullptr;
+           node = &pos->second;
+        }
+        else if(const JsonValue::Array * array = arrayOf(*node))
+        {
+           std::size_t index;
+           if(!parseIndex(tokens[i], array->count(), index) || index == array->count()) return nullptr;
+           node = &array->getVector()[index];
+        }
+        else return nullptr;
+    }
+
+    return node;
+}
+
+bool JsonPatch::add(JsonValue & document, const std::vector<std::string> & tokens, JsonValue value)
+{
+    if(tokens.empty())
+    {
+       steps.clear();
+       document = std::move(value);
+       return true;
+    }
+
+    JsonValue * parent = resolveParent(document, tokens);
+    if(parent == nullptr) return false;
+    const std::string & token = tokens.back();
+
+    if(objectOf(*parent) != nullptr)
+    {
+       parent->editObject()[token] = std::move(value);
+       return true;
+    }
+
+    const JsonValue::Array * array = arrayOf(*parent);
+    if(array == nullptr) return false;
+
+    std::size_t index = array->count();
+    if(token != "-" && !parseIndex(token, array->count(), index)) return false;
+
+    //appending keeps the array indexes up to date
+    if(index == array->count()) parent->editArray().append(std::move(value));
+    else
+    {
+       JsonValue::Array::Vector & vector = parent->editArray().getVector();
+       vector.insert(vector.begin() + static_cast<std::ptrdiff_t>(index), std::move(value));
+    }
+
+    return true;
+}
+
+bool JsonPatch::remove(JsonValue & document, const std::vector<std::string> & tokens, JsonValue * removed)
+{
+    //the document itself is never removed
+    if(tokens.empty()) return false;
+
+    JsonValue * parent = resolveParent(document, tokens);
+    if(parent == nullptr) return false;
+    const std::string & token = tokens.back();
+
+    if(const JsonValue::Object * object = objectOf(*parent))
+    {
+       if(!object->contains(token)) return false;
+       JsonValue::Object::Map & map = parent->editObject().getMap();
+       auto pos = map.find(token);
+       if(removed != nullptr) *removed = std::move(pos->second);
+       map.erase(pos);
+       return true;
+    }
+
+    const JsonValue::Array * array = arrayOf(*parent);
+    std::size_t index;
+    if(array == nullptr || !parseIndex(token, array->count(), index) || index == array->count()) return false;
 
-bool JsonSAXWriter::writeSpace(int count)
-{
-    for(int i = 0; i < count; i++){ if(!writeChar(' ')) return false; }
+    JsonValue::Array::Vector & vector = parent->editArray().getVector();
+    if(removed != nullptr) *removed = std::move(vector[index]);
+    vector.erase(vector.begin() + static_cast<std::ptrdiff_t>(index));
     return true;
 }
 
-bool JsonSAXWriter::checkCorrectValue()
+bool JsonPatch::replace(JsonValue & document, const std::vector<std::string> & tokens, JsonValue value)
 {
-    if(!stack.empty() && (stack.top() == Сondition::Object || stack.top() == Сondition::ObjectNextPair))
+    if(tokens.empty())
     {
-       _error = InvalidOperation;
-       return false;
+       steps.clear();
+       document = std::move(value);
+       return true;
     }
 
-    if(stack.top() == Сondition::ArrayNextValue)
-    {
-       if(!writeChar(',') || (beautiful && (!writeChar('\n') || !writeSpace(2 * stack.size())))) return false;
-    }
-    else if(stack.top() == Сondition::ObjectKey) stack.top() = Сondition::ObjectNextPair;
-    else if(stack.top() ==  Сondition::Array)
+    JsonValue * parent = resolveParent(document, tokens);
+    if(parent == nullptr) return false;
+    const std::string & token = tokens.back();
+
+    if(const JsonValue::Object * object = objectOf(*parent))
     {
-       if(beautiful && !writeSpace(2 * stack.size())) return false;
-       stack.top() = Сondition::ArrayNextValue;
+       if(!object->contains(token)) return false;
+       parent->editObject()[token] = std::move(value);
+       return true;
     }
 
+    const JsonValue::Array * array = arrayOf(*parent);
+    std::size_t index;
+    if(array == nullptr || !parseIndex(token, array->count(), index) || index == array->count()) return false;
+
+    parent->editArray().getVector()[index] = std::move(value);
     return true;
 }
 
-bool JsonSAXWriter::containerEnd()
+bool JsonPatch::applyOperation(JsonValue & document, const JsonValue & operation, std::size_t index)
 {
-    if(!stack.empty())
+    const JsonValue::Object * fields = objectOf(operation);
+    if(fields == nullptr) return fail(InvalidPatchOperationMsg, index);
+
+    const JsonValue::Object::Map & map = fields->getMap();
+    auto member = [&map](const char * name) -> const JsonValue *
     {
-       if(stack.top() == Сondition::ArrayNextValue)
-       {
-          if(!writeChar(',') || (beautiful && (!writeChar('\n') || !writeSpace(2 * stack.size())))) return false;
-       }
-       else if(stack.top() == Сondition::ObjectKey) stack.top() = Сondition::ObjectNextPair;
-       else if(stack.top() ==  Сondition::Array)
+        auto pos = map.find(name);
+        return (pos != map.end()) ? &pos->second : nullptr;
+    };
+
+    const JsonValue * op = member("op");
+    const JsonValue * pointer = member("path");
+    const JsonValue * value = member("value");
+    const JsonValue * source = member("from");
+
+    if(op == nullptr || op->type() != JsonType::String || pointer == nullptr || pointer->type() != JsonType::String) return fail(InvalidPatchOperationMsg, index);
+    if(!parsePointer(std::get<std::string>(pointer->getValue()), path)) return fail(InvalidPointerMsg, index);
+
+    const std::string & name = std::get<std::string>(op->getValue());
+
+    if(name == "add" || name == "replace" || name == "test")
+    {
+       if(value == nullptr) return fail(InvalidPatchOperationMsg, index);
+
+       if(name == "test")
        {
-          if(beautiful && !writeSpace(2 * stack.size())) return false;
-          stack.top() = Сondition::ArrayNextValue;
+          const JsonValue * target = find(document, path);
+          if(target == nullptr) return fail(PathNotFoundMsg, index);
+          return equal(*target, *value) || fail(TestFailedMsg, index);
        }
+
+       const bool ret = (name == "add") ? add(document, path, value->snapshot()) : replace(document, path, value->snapshot());
+       return ret || fail(PathNotFoundMsg, index);
     }
 
-    return true;
-}
+    if(name == "remove") return remove(document, path, nullptr) || fail(PathNotFoundMsg, index);
+    if(name != "move" && name != "copy") return fail(InvalidPatchOperationMsg, index);
 
-bool JsonSAXWriter::checkIsNotObject()
-{
-    if(!stack.empty() && (stack.top() == Сondition::Object || stack.top() == Сondition::ObjectNextPair))
+    if(source == nullptr || source->type() != JsonType::String) return fail(InvalidPatchOperationMsg, index);
+    if(!parsePointer(std::get<std::string>(source->getValue()), from)) return fail(InvalidPointerMsg, index);
+
+    if(name == "copy")
     {
-       _error = InvalidOperation;
-       return false;
+       const JsonValue * target = find(document, from);
+       if(target == nullptr) return fail(PathNotFoundMsg, index);
+       JsonValue copy = target->snapshot();
+
+       //containers of the source are shared with the copy now, the path is edited again from the document
+       steps.resize(std::min<std::size_t>(steps.size(), 1));
+       return add(document, path, std::move(copy)) || fail(PathNotFoundMsg, index);
     }
 
-    return true;
+    if(from.size() < path.size() && std::equal(from.begin(), from.end(), path.begin())) return fail(MoveIntoChildMsg, index);
+    if(from == path) return find(document, from) != nullptr || fail(PathNotFoundMsg, index);
+
+    JsonValue moved;
+    if(!remove(document, from, &moved)) return fail(PathNotFoundMsg, index);
+    return add(document, path, std::move(moved)) || fail(PathNotFoundMsg, index);
 }
 
-bool JsonSAXWriter::checkIsObject(bool key, bool end)
+bool JsonPatch::apply(JsonValue & document, const JsonValue & patch)
 {
-    if(stack.empty() || (stack.top() != Сondition::Object && stack.top() != Сondition::ObjectNextPair))
+    _error.clear();
+    steps.clear();
+
+    //a patch that is the document itself keeps its operations while the document is edited
+    const JsonValue operations = patch.snapshot();
+    const JsonValue::Array * array = arrayOf(operations);
+
+    if(array == nullptr)
     {
-       _error = InvalidOperation;
+       _error = InvalidPatchMsg;
        return false;
     }
 
-    if(key && stack.top() == Сondition::ObjectNextPair)
-    {
-       if(!writeChar(',') || (beautiful && (!writeChar('\n') || !writeSpace(2 * stack.size())))) return false;
-    }
-    else if(beautiful && !writeSpace((end) ? (2 * stack.size()) - 2 : 2 * stack.size())) return false;
+    JsonValue saved;
+    if(atomic) saved = document.snapshot();
 
-    return true;
+    const JsonValue::Array::Vector & items = array->getVector();
+    bool ret = true;
+
+    for(std::size_t i = 0; i < items.size() && ret; i++) ret = applyOperation(document, items[i], i);
+
+    if(!ret && atomic) document = std::move(saved);
+    steps.clear();
+    return ret;
 }
 
-bool JsonSAXWriter::writeString(const std::string & string)
+bool JsonPatch::equal(const JsonValue & first, const JsonValue & second)
 {
-    if(!writeChar('"')) return false;
+    std::vector<std::pair<const JsonValue::Value *, const JsonValue::Value *>> pending = {{&first.getValue(), &second.getValue()}};
 
-    for(unsigned char c : string)
+    while(!pending.empty())
     {
-        switch (c)
+        auto [left, right] = pending.back();
+        pending.pop_back();
+        if(left == right) continue;
+
+        const JsonType type = static_cast<JsonType>(left->index());
+
+        if(type != static_cast<JsonType>(right->index()))
         {
-           case '"': if(!writeChar('\\') || !writeChar('"')) return false;
-           break;
-           case '\\': if(!writeChar('\\') || !writeChar('\\')) return false;
+           if(type == JsonType::Double && right->index() == static_cast<std::size_t>(JsonType::LongLong) && sameNumber(std::get<double>(*left), std::get<long long>(*right))) continue;
+           if(type == JsonType::LongLong && right->index() == static_cast<std::size_t>(JsonType::Double) && sameNumber(std::get<double>(*right), std::get<long long>(*left))) continue;
+           return false;
+        }
+
+        switch(type)
+        {
+           case JsonType::Object:
+           {
+              const JsonValue::Object::Map & a = std::get<JsonValue::Object>(*left).getMap();
+              const JsonValue::Object::Map & b = std::get<JsonValue::Object>(*right).getMap();
+              if(&a == &b) continue;
+              if(a.size() != b.size()) return false;
+
+              //both maps are sorted by key
+              for(auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j)
+              {
+                  if(i->first != j->first) return false;
+                  pending.emplace_back(&i->second.getValue(), &j->second.getValue());
+              }
+           }
            break;
-           case '/': if(!writeChar('\\') || !writeChar('/')) return false;
+           case JsonType::Array:
+           {
+              const JsonValue::Array::Vector & a = std::get<JsonValue::Array>(*left).getVector();
+              const JsonValue::Array::Vector & b = std::get<JsonValue::Array>(*right).getVector();
+              if(&a == &b) continue;
+              if(a.size() != b.size()) return false;
+              for(std::size_t i = 0; i < a.size(); i++) pending.emplace_back(&a[i].getValue(), &b[i].getValue());
+           }
            break;
-           case '\b': if(!writeChar('\\') || !writeChar('b')) return false;
+           case JsonType::String: if(std::get<std::string>(*left) != std::get<std::string>(*right)) return false;
            break;
-           case '\f': if(!writeChar('\\') || !writeChar('f')) return false;
+           case JsonType::Double: if(std::get<double>(*left) != std::get<double>(*right)) return false;
            break;
-           case '\n': if(!writeChar('\\') || !writeChar('n')) return false;
+           case JsonType::LongLong: if(std::get<long long>(*left) != std::get<long long>(*right)) return false;
            break;
-           case '\r': if(!writeChar('\\') || !writeChar('r')) return false;
+           case JsonType::Bool: if(std::get<bool>(*left) != std::get<bool>(*right)) return false;
            break;
-           case '\t': if(!writeChar('\\') || !writeChar('t')) return false;
+           case JsonType::Raw: if(std::get<JsonValue::Raw>(*left).json != std::get<JsonValue::Raw>(*right).json) return false;
            break;
-           default: if(!writeChar(c)) return false;
+           default: break;
         }
     }
 
-    if(!writeChar('"')) return false;
-
     return true;
 }
 
-void JsonSAXWriter::setError(const std::string & error){ _error = error; }
+//token of a JSON Pointer with '~' and '/' escaped
+static void appendToken(std::string & pointer, std::string_view token)
+{
+    pointer.push_back('/');
 
-JsonSAXWriter::JsonSAXWriter(){}
+    for(char c : token)
+    {
+        if(c == '~') pointer.append("~0");
+        else if(c == '/') pointer.append("~1");
+        else pointer.push_back(c);
+    }
+}
 
-std::string JsonSAXWriter::error() const { return std::move(_error); }
+bool JsonPatch::sameValue(const JsonValue::Value & first, const JsonValue::Value & second)
+{
+    if(&first == &second) return true;
+    if(first.index() != second.index()) return false;
 
-void JsonSAXWriter::setBuffer(JsonBufferWriter * buffer, bool beautiful)
+    const JsonValue::Slot * a = JsonValue::slotOf(first);
+    const JsonValue::Slot * b = JsonValue::slotOf(second);
+    if(a == nullptr) return JsonValue::scalarEqual(first, second);
+    if(a == b) return true;
+
+    //unshared containers with equal memoized hashes are compared instead of diffed
+    return a->memoized() && b->memoized() && a->hash == b->hash && JsonValue::equal(first, second);
+}
+
+JsonValue JsonPatch::diff(const JsonValue & source, const JsonValue & target)
 {
-    while(!stack.empty()) stack.pop();
-    this->buffer = buffer;
-    this->beautiful = beautiful;
+    JsonValue ret = JsonValue::Array();
+    JsonValue::Array & operations = ret.editArray();
+
+    auto emit = [&operations](const char * op, const std::string & path, const JsonValue * value)
+    {
+        JsonValue::Object operation;
+        operation.insert("op", op);
+        operation.insert("path", path);
+        if(value != nullptr) operation.insert("value", value->snapshot());
+        operations.append(operation);
+    };
+
+    struct Pending
+    {
+        std::string path;
+        const JsonValue * first;
+        const JsonValue * second;
+    };
+
+    std::vector<Pending> pending;
+    if(!sameValue(source.getValue(), target.getValue())) pending.push_back({{}, &source, &target});
+
+    while(!pending.empty())
+    {
+        const Pending item = std::move(pending.back());
+        pending.pop_back();
+
+        const JsonValue::Object * first = objectOf(*item.first);
+        const JsonValue::Object * second = objectOf(*item.second);
+
+        if(first != nullptr && second != nullptr)
+        {
+           //both maps are sorted by key
+           const JsonValue::Object::Map & a = first->getMap();
+           const JsonValue::Object::Map & b = second->getMap();
+           auto i = a.begin();
+           auto j = b.begin();
+
+           while(i != a.end() || j != b.end())
+           {
+               const bool removed = (j == b.end() || (i != a.end() && i->first < j->first));
+               const bool added = !removed && (i == a.end() || j->first < i->first);
+
+               if(!removed && !added && sameValue(i->second.getValue(), j->second.getValue()))
+               {
+                  ++i;
+                  ++j;
+                  continue;
+               }
+
+               std::string path = item.path;
+               appendToken(path, (removed) ? i->first : j->first);
+
+               if(removed) emit("remove", path, nullptr);
+               else if(added) emit("add", path, &j->second);
+               else pending.push_back({std::move(path), &i->second, &j->second});
+
+               if(!added) ++i;
+               if(!removed) ++j;
+           }
+
+           continue;
+        }
+
+        const JsonValue::Array * firstArray = arrayOf(*item.first);
+        const JsonValue::Array * secondArray = arrayOf(*item.second);
+
+        if(firstArray == nullptr || secondArray == nullptr)
+        {
+           emit("replace", item.path, item.second);
+           continue;
+        }
+
+        const JsonValue::Array::Vector & a = firstArray->getVector();
+        const JsonValue::Array::Vector & b = secondArray->getVector();
+        std::size_t head = 0;
+        std::size_t tail = 0;
+
+        while(head < a.size() && head < b.size() && sameValue(a[head].getValue(), b[head].getValue())) head++;
+        while(tail < a.size() - head && tail < b.size() - head && sameValue(a[a.size() - 1 - tail].getValue(), b[b.size() - 1 - tail].getValue())) tail++;
+
+        //the items between are paired by position, the rest of the longer side is removed or added
+        //after the pairs, so the paths of the pairs keep their indexes
+        const std::size_t removed = a.size() - head - tail;
+        const std::size_t added = b.size() - head - tail;
+        const std::size_t paired = std::min(removed, added);
+
+        for(std::size_t k = 0; k < paired; k++)
+        {
+            if(sameValue(a[head + k].getValue(), b[head + k].getValue())) continue;
+            std::string path = item.path;
+            appendToken(path, std::to_string(head + k));
+            pending.push_back({std::move(path), &a[head + k], &b[head + k]});
+        }
+
+        for(std::size_t k = paired; k < std::max(removed, added); k++)
+        {
+            std::string path = item.path;
+            appendToken(path, std::to_string(head + ((removed > added) ? paired : k)));
+            emit((removed > added) ? "remove" : "add", path, (removed > added) ? nullptr : &b[head + k]);
+        }
+    }
+
+    return ret;
 }
 
-bool JsonSAXWriter::ObjectBegin()
+void JsonPatch::merge(JsonValue & document, const JsonValue & patch)
 {
-    if(!checkBuffer() || !checkIsNotObject() || !containerEnd() || !writeChar('{')) return false;
-    if(beautiful && !writeChar('\n')) return false;
-    stack.push(Сondition::Object);
-    return true;
+    const JsonValue::Object * root = objectOf(patch);
+
+    if(root == nullptr)
+    {
+       document = patch.snapshot();
+       return;
+    }
+
+    std::vector<std::pair<JsonValue *, const JsonValue::Object::Map *>> pending = {{&document, &root->getMap()}};
+
+    while(!pending.empty())
+    {
+        auto [target, changes] = pending.back();
+        pending.pop_back();
+
+        //not an object - merged into an empty object
+        JsonValue::Object & object = target->editObject();
+
+        for(const auto & [key, change] : *changes)
+        {
+            if(const JsonValue::Object * nested = objectOf(change)) pending.emplace_back(&target->edit(key), &nested->getMap());
+            else if(change.type() == JsonType::Null) object.remove(key);
+            else object[key] = change.snapshot();
+        }
+    }
 }
 
-bool JsonSAXWriter::ObjectKey(const std::string & key)
+//----------------------------------------------------------------
+
+JsonType JsonDocument::View::type() const { return (value != nullptr) ? static_cast<JsonType>(value->index()) : JsonType::Empty; }
+
+std::size_t JsonDocument::View::count() const
 {
-    if(!checkBuffer() || !checkIsObject(true, false) || !writeString(key) || !writeChar(':')) return false;
-    stack.top() = Сondition::ObjectKey;
-    return true;
+    if(const JsonValue::Object::Map * map = object()) return map->size();
+    if(const JsonValue::Array::Vector * vector = array()) return vector->size();
+    return 0;
 }
 
-bool JsonSAXWriter::ObjectEnd()
+JsonDocument::View JsonDocument::View::operator[](const std::string & key) const
 {
-    if(!checkBuffer() || (beautiful && !writeChar('\n')) || !checkIsObject(false, true) || !writeChar('}')) return false;
-    stack.pop();
-    return true;
+    const JsonValue::Object::Map * map = object();
+    if(map == nullptr) return View();
+
+    auto pos = map->find(key);
+    return (pos != map->end()) ? View(&pos->second.getValue()) : View();
 }
 
-bool JsonSAXWriter::ArrayBegin()
+JsonDocument::View JsonDocument::View::operator[](std::size_t index) const
 {
-    if(!checkBuffer() || !checkIsNotObject() || !containerEnd() || !writeChar('[')) return false;
-    if(beautiful && !writeChar('\n')) return false;
-    stack.push(Сondition::Array);
-    return true;
+    const JsonValue::Array::Vector * vector = array();
+    return (vector != nullptr && index < vector->size()) ? View(&(*vector)[index].getValue()) : View();
 }
 
-bool JsonSAXWriter::ArrayEnd()
+bool JsonDocument::View::forEach(const std::function<bool(std::string_view key, View value)> & callback) const
 {
-    if(!checkBuffer()) return false;
-    if(stack.empty() && (stack.top() != Сondition::Array))
+    if(const JsonValue::Object::Map * map = object())
     {
-       _error = InvalidOperation;
-       return false;
+       for(const auto & [key, item] : *map){ if(!callback(key, View(&item.getValue()))) return false; }
+    }
+    else if(const JsonValue::Array::Vector * vector = array())
+    {
+       for(const JsonValue & item : *vector){ if(!callback({}, View(&item.getValue()))) return false; }
     }
 
-    stack.pop();
-    if((beautiful && (!writeChar('\n') || !writeSpace(2 * stack.size()))) || !writeChar(']')) return false;
     return true;
 }
 
-bool JsonSAXWriter::Value(const std::string & value)
+const JsonValue::Object::Map * JsonDocument::View::object() const
 {
-    if(!checkBuffer() || !checkCorrectValue()) return false;
-    if(!writeString(value)) return false;
-    return true;
+    const JsonValue::Object * object = (value != nullptr) ? std::get_if<JsonValue::Object>(value) : nullptr;
+    return (object != nullptr) ? &object->getMap() : nullptr;
 }
 
-bool JsonSAXWriter::Value(double value)
+const JsonValue::Array::Vector * JsonDocument::View::array() const
 {
-    if(!checkBuffer() || !checkCorrectValue()) return false;
-    std::array<char, 18> data;
-    auto [ptr, ec] = std::to_chars(data.data(), data.data() + data.size(), value);
-
-    if(ec != std::errc())
-    {
-       _error = ErrorConvDouble;
-       return false;
-    }
-
-    std::string_view str(data.data(), ptr);
-    for(unsigned char ch : str) if(!writeChar(ch)) return false;
-
-    return true;
+    const JsonValue::Array * array = (value != nullptr) ? std::get_if<JsonValue::Array>(value) : nullptr;
+    return (array != nullptr) ? &array->getVector() : nullptr;
 }
 
-bool JsonSAXWriter::Value(long long value)
+std::string_view JsonDocument::View::getString() const
 {
-    if(!checkBuffer() || !checkCorrectValue()) return false;
-    std::array<char, 20> data;
-    auto [ptr, ec] = std::to_chars(data.data(), data.data() + data.size(), value);
-
-    if(ec != std::errc())
-    {
-       _error = ErrorConvLongLong;
-       return false;
-    }
+    const std::string * string = (value != nullptr) ? std::get_if<std::string>(value) : nullptr;
+    return (string != nullptr) ? std::string_view(*string) : std::string_view();
+}
 
-    std::string_view str(data.data(), ptr);
-    for(unsigned char ch : str) if(!writeChar(ch)) return false;
-    return true;
+double JsonDocument::View::getDouble() const
+{
+    const double * val = (value != nullptr) ? std::get_if<double>(value) : nullptr;
+    return (val != nullptr) ? *val : 0.0;
 }
 
-static const std::string_view S_True("true"), S_False("false"), S_Null("null");
+long long JsonDocument::View::getLongLong() const
+{
+    const long long * val = (value != nullptr) ? std::get_if<long long>(value) : nullptr;
+    return (val != nullptr) ? *val : 0;
+}
 
-bool JsonSAXWriter::Value(bool value)
+bool JsonDocument::View::getBool() const
 {
-    if(!checkBuffer() || !checkCorrectValue()) return false;
-    if(value)for(unsigned char ch : S_True){ if(!writeChar(ch)) return false; }
-    else for(unsigned char ch : S_False) if(!writeChar(ch)) return false;
-    return true;
+    const bool * val = (value != nullptr) ? std::get_if<bool>(value) : nullptr;
+    return (val != nullptr) ? *val : false;
 }
 
-bool JsonSAXWriter::Null()
+bool JsonDocument::View::getNull() const { return type() == JsonType::Null; }
+
+std::string_view JsonDocument::View::getRaw() const
 {
-    if(!checkBuffer() || !checkCorrectValue()) return false;
-    for(unsigned char ch : S_Null) if(!writeChar(ch)) return false;
-    return true;
+    const JsonValue::Raw * raw = (value != nullptr) ? std::get_if<JsonValue::Raw>(value) : nullptr;
+    return (raw != nullptr) ? std::string_view(raw->json) : std::string_view();
 }
 
-//-----------------------------------------------------------------------------
+JsonDocument::JsonDocument(){}
+
+JsonDocument::JsonDocument(const JsonValue & root) : _root(root.clone()){}
 
-bool JsonWriter::writeValue(JsonValue & value)
+bool JsonDocument::parse(std::string_view json, JsonFormat format)
 {
-    switch (value.type())
+    JsonReader reader;
+    JsonValue value = reader.parse(json, format);
+
+    if(value.isEmpty())
     {
-       case JsonType::String: if(!Value(value.getString())) return false;
-       break;
-       case JsonType::Double: if(!Value(value.getDouble())) return false;
-       break;
-       case JsonType::LongLong: if(!Value(value.getLongLong())) return false;
-       break;
-       case JsonType::Bool: if(!Value(value.getBool())) return false;
-       break;
-       case JsonType::Null: if(!Null()) return false;
-       break;
-       default:
-       {
-          setError("Invalid json value is empty type");
-          return false;
-       }
-       break;
+       _error = reader.error();
+       return false;
     }
 
+    _root = std::move(value);
     return true;
 }
 
-JsonWriter::JsonWriter(){}
-
-bool JsonWriter::write(JsonBufferWriter & buffer, const JsonValue & json, bool beautiful)
+bool JsonDocument::parseFromFile(const std::string & fileName, JsonFormat format)
 {
-    if(json.type() != JsonType::Object && json.type() != JsonType::Array) return false;
-    using Variant = std::variant<std::monostate,JsonValue::Object::Map::iterator,JsonValue::Array::Vector::iterator>;
+    JsonReader reader;
+    JsonValue value = reader.parseFromFile(fileName, format);
 
-    std::list<std::pair<JsonValue *, Variant>> stack;
-    stack.push_back({&const_cast<JsonValue&>(json), Variant()});
+    if(value.isEmpty())
+    {
+       _error = reader.error();
+       return false;
+    }
 
-    setBuffer(&buffer, beautiful);
+    _root = std::move(value);
+    return true;
+}
 
-    while(!stack.empty())
-    {
-       if(stack.back().first->type() == JsonType::Object)
-       {
-          JsonValue::Object object = *stack.back().first;
-          JsonValue::Object::Map::iterator pos = (stack.back().second.index() > 0) ? std::get<1>(stack.back().second) : object.map->begin();
-          if(pos == object.map->begin()){ if(!ObjectBegin()) return false; }
+std::string JsonDocument::error() const { return _error; }
 
-          bool next_container = false;
-          while(pos != object.map->end())
-          {
-             if(!ObjectKey(pos->first)) return false;
+JsonDocument::View JsonDocument::root() const { return View(&_root.getValue()); }
 
-             JsonValue & value = pos->second;
-             if(value.type() == JsonType::Object || value.type() == JsonType::Array)
-             {
-                int count = 0;
-                for(const auto & pair : stack)
-                {
-                    if(pair.first->value.get() == value.value.get())
-                    {
-                       count++;
-                       break;
-                    }
-                }
-
-                if(count == 0)
-                {
-                   pos++;
-                   stack.back().second = pos;
-                   stack.push_back({&value, Variant()});
-                   next_container = true;
-                   break;
-                }
-                else if(!Null()) return false;
-             }
-             else if(!writeValue(value)) return false;
-             pos++;
-          }
+//the writer only reads the tree while its cache is off
+bool JsonDocument::write(JsonBufferWriter & buffer, bool beautiful) const
+{
+    JsonWriter writer;
+    return writer.write(buffer, _root, beautiful);
+}
 
-          if(next_container) continue;
-          if(!ObjectEnd()) return false;
-       }
-       else
-       {
-          JsonValue::Array array = *stack.back().first;
-          JsonValue::Array::Vector::iterator pos = (stack.back().second.index() > 0) ? std::get<2>(stack.back().second) : array.array->begin();
-          if(pos == array.array->begin()){ if(!ArrayBegin()) return false; }
+std::string JsonDocument::write(bool beautiful) const
+{
+    JsonWriter writer;
+    return writer.write(_root, beautiful);
+}
 
-          bool next_container = false;
-          while(pos != array.array->end())
-          {
-             JsonValue & value = *pos;
-             if(value.type() == JsonType::Object || value.type() == JsonType::Array)
-             {
-                int count = 0;
-                for(const auto & pair : stack)
-                {
-                    if(pair.first->value.get() == value.value.get())
-                    {
-                       count++;
-                       break;
-                    }
-                }
-
-                if(count == 0)
-                {
-                   pos++;
-                   stack.back().second = pos;
-                   stack.push_back({&value, Variant()});
-                   next_container = true;
-                   break;
-                }
-                else if(!Null()) return false;
-             }
-             else if(!writeValue(value)) return false;
-             pos++;
-          }
+//----------------------------------------------------------------
 
-          if(next_container) continue;
-          if(!ArrayEnd()) return false;
-       }
+JsonPublisher::Reader::Reader(const JsonPublisher & publisher) : publisher(&publisher){}
 
-       stack.pop_back();
+const JsonDocument & JsonPublisher::Reader::get()
+{
+    const std::uint64_t current = publisher->_version.load(std::memory_order_acquire);
+
+    if(document == nullptr || current != version)
+    {
+       document = publisher->load();
+       version = current;
     }
 
-    return true;
+    return *document;
 }
 
-bool JsonWriter::write(std::string & string, const JsonValue & json, bool beautiful)
+//readers always get a document, nullptr publishes an empty one
+static std::shared_ptr<const JsonDocument> publishedDocument(std::shared_ptr<const JsonDocument> && document)
 {
-    JsonStringBufferWriter buffer;
-    if(!write(buffer, json, beautiful)) return false;
-    string = std::move(const_cast<std::string &>(buffer.result()));
-    return true;
+    return (document != nullptr) ? std::move(document) : std::make_shared<const JsonDocument>();
 }
 
-std::string JsonWriter::write(const JsonValue & json, bool beautiful)
+JsonPublisher::JsonPublisher() : current(std::make_shared<const JsonDocument>()){}
+
+JsonPublisher::JsonPublisher(std::shared_ptr<const JsonDocument> document) : current(publishedDocument(std::move(document))){}
+
+void JsonPublisher::publish(std::shared_ptr<const JsonDocument> document)
 {
-    std::string ret;
-    write(ret, json, beautiful);
-    return ret;
+    document = publishedDocument(std::move(document));
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        current.swap(document);
+        _version.fetch_add(1, std::memory_order_release);
+    }
+
+    //the previous document is released outside of the lock
 }
 
-bool JsonWriter::writeToFile(const std::string & fileName, const JsonValue & json, bool beautiful)
+std::shared_ptr<const JsonDocument> JsonPublisher::load() const
 {
-    JsonFileBufferWriter buffer;
-    if(!buffer.open(fileName) || !write(buffer, json, beautiful)) return false;
-    return true;
+    std::lock_guard<std::mutex> guard(lock);
+    return current;
 }
+
+std::uint64_t JsonPublisher::version() const { return _version.load(std::memory_order_acquire); }
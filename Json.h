@@ -3,18 +3,31 @@
 
 #include <string>
 #include <map>
+#include <unordered_set>
+#include <unordered_map>
 #include <vector>
 #include <variant>
 #include <memory>
+#include <memory_resource>
 #include <stack>
 #include <functional>
 #include <fstream>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+using JsonSegment = iovec;
+#else
+struct JsonSegment
+{
+    void * iov_base;
+    std::size_t iov_len;
+};
+#endif
 
-//Need JSON5
-//Need comment
-//Need parent
-//Need (Up <- tree search -> Down, All)
-//set recursive depth tree
 //json query value
 
 class JsonBufferReader
@@ -26,6 +39,8 @@ public:
     virtual bool next() = 0;
     virtual unsigned char value() = 0;
     virtual std::size_t offset() = 0;
+    //Input between two offsets (inclusive) read before, false - the reader does not keep its input
+    virtual bool copy(std::size_t first, std::size_t last, std::string & data){ (void)first; (void)last; (void)data; return false; }
 };
 
 class JsonStringViewBufferReader : public JsonBufferReader
@@ -38,6 +53,7 @@ public:
     bool next() override;
     unsigned char value() override;
     std::size_t offset() override;
+    bool copy(std::size_t first, std::size_t last, std::string & data) override;
 };
 
 class JsonFileBufferReader : public JsonBufferReader
@@ -54,15 +70,80 @@ public:
     bool next() override;
     unsigned char value() override;
     std::size_t offset() override;
+    bool copy(std::size_t first, std::size_t last, std::string & data) override;
+};
+
+enum class JsonFormat : unsigned char
+{
+   Text = 0,
+   MessagePack,
+   CBOR,
+   JSON5, //reading - JSON5 text: comments, trailing commas, keys without quotes, single quotes, hex numbers, Infinity, NaN; writing - JSON text
+   Canonical //reading - JSON text; writing - RFC 8785 canonical JSON: keys in UTF-16 order, ECMAScript numbers, minimal escaping, no whitespace
 };
 
-class JsonSAXReader
+enum class JsonReaderType : unsigned char;
+
+//Counters of JsonSAXReader and JsonSAXWriter, collected when the library is built with JSON_STATS
+//defined (CMake option JSONPARSER_STATS). Without it the hooks are compiled out and the counters
+//stay zero. Counters add up over calls until resetStats(). Cycles: rdtsc ticks on x86-64,
+//nanoseconds elsewhere.
+struct JsonStats
+{
+#if defined(JSON_STATS)
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    std::uint64_t bytes = 0;         //documents read, output of JsonWriter::write
+    std::uint64_t objects = 0;
+    std::uint64_t arrays = 0;
+    std::uint64_t keys = 0;
+    std::uint64_t strings = 0;
+    std::uint64_t doubles = 0;
+    std::uint64_t integers = 0;
+    std::uint64_t bools = 0;
+    std::uint64_t nulls = 0;
+    std::uint64_t maxDepth = 0;
+    std::uint64_t stringBytes = 0;   //keys and string values, decoded
+    std::uint64_t escapes = 0;       //escape sequences in text keys and string values
+    std::uint64_t allocations = 0;   //scratch and frame growth, JsonReader tree nodes, JsonWriter cache fragments
+
+    std::uint64_t totalCycles = 0;   //JsonSAXReader::parse, JsonWriter::write
+    std::uint64_t stringCycles = 0;  //decoding or escaping keys and string values
+    std::uint64_t numberCycles = 0;  //reading or formatting numbers
+    std::uint64_t handlerCycles = 0; //reader callbacks, for JsonReader - building the tree
+};
+
+//Parser of the text and binary formats, the handler type is a template argument of parse(): its
+//callbacks are resolved at compile time and inlined into the tokenizer. A handler has the callbacks
+//of JsonSAXReader (JsonBegin ... Null), public or private with JsonSAXParser as a friend.
+//parse() is defined in JsonSAXParser.h, include it where parse() is called with a handler.
+//JsonSAXReader is the handler with virtual callbacks, for handlers chosen at run time.
+class JsonSAXParser
 {
     std::string _error;
     bool stop;
 
+    //Parser state is kept between parse calls, steady-state parsing does not allocate
+    struct BinaryFrame
+    {
+        std::size_t remaining; //definite length: items (pairs for object) left
+        bool object;
+        bool key;              //object: key is read, value expected
+        bool indefinite;
+    };
+
+    std::stack<JsonReaderType, std::vector<JsonReaderType>> depth;
+    std::stack<BinaryFrame, std::vector<BinaryFrame>> frames;
+    std::string temp;
+
+    static constexpr std::size_t NoLimit = static_cast<std::size_t>(-1);
+    std::size_t maxDepth = NoLimit, maxTokens = NoLimit, maxString = NoLimit, maxBytes = NoLimit;
+
 protected:
-    void stopParse();
+    JsonStats _stats;
 
 public:
 
@@ -72,11 +153,48 @@ public:
         Multiple
     };
 
+    //Limits of a single document, 0 - no limit
+    struct Limits
+    {
+        std::size_t depth = 0;  //nesting of objects and arrays
+        std::size_t tokens = 0; //keys, values, objects and arrays
+        std::size_t string = 0; //decoded length of a key or a string value
+        std::size_t bytes = 0;  //input bytes
+    };
+
+    explicit JsonSAXParser();
+
+    void setLimits(const Limits & limits);
+    Limits limits() const;
+
+    std::string error() const;
+    template<typename Handler>
+    bool parse(Handler & handler, JsonBufferReader & buffer, Operation operation, JsonFormat format = JsonFormat::Text);
+    //Called by a handler: Multiple stops after the current document
+    void stopParse();
+
+    const JsonStats & stats() const;
+    void resetStats();
+
+private:
+    Limits _limits;
+
+    template<typename Handler>
+    struct Callbacks;
+
+    template<bool Json5, typename Handler>
+    bool parseText(Handler & handler, JsonBufferReader & buffer, Operation operation);
+    template<typename Handler>
+    bool parseBinary(Handler & handler, JsonBufferReader & buffer, Operation operation, JsonFormat format);
+};
+
+class JsonSAXReader : public JsonSAXParser
+{
+public:
     explicit JsonSAXReader();
     virtual ~JsonSAXReader();
 
-    std::string error() const;
-    bool parse(JsonBufferReader & buffer, Operation operation);
+    bool parse(JsonBufferReader & buffer, Operation operation, JsonFormat format = JsonFormat::Text);
 
     virtual void JsonBegin() = 0;
     virtual void JsonEnd() = 0;
@@ -104,31 +222,64 @@ enum class JsonType : unsigned char
    Double,
    LongLong,
    Bool,
-   Null
+   Null,
+   Raw
+};
+
+enum class JsonSearch : unsigned char
+{
+   DepthFirst = 0, //pre-order, children in document order
+   BreadthFirst
 };
 
 class JsonValue final
 {
     friend class JsonReader;
     friend class JsonWriter;
+    friend class JsonPatch;
+
+    //JsonWriter cache: text of a container, holes - offsets where child containers are spliced in
+    struct Fragment
+    {
+       std::string text;
+       std::vector<std::size_t> holes;
+       std::size_t level = 0;
+       std::size_t indent = 0;
+       bool beautiful = false;
+       bool tabs = false;
+       bool compact = false;
+    };
+
+    using Cache = std::atomic<Fragment *>; //owned by the slot
+    struct Index;
+    struct Slot;
 
 public:
 
     class Object final
     {
+       friend class JsonValue;
        friend class JsonReader;
        friend class JsonWriter;
 
      public:
-       using Map = std::map<std::string, JsonValue>;
+       using Map = std::pmr::map<std::string, JsonValue>;
        explicit Object();
        Object(const Map & map);
+       Object(Map && map);
        Object copy() const;
 
        std::size_t count() const;
        bool contains(const std::string & key) const;
        JsonValue value(const std::string & key) const;
-       void insert(const std::string & key, const JsonValue & value) const;
+       //Key and value are moved into the map, an existing key keeps its value
+       void insert(std::string key, JsonValue value) const;
+       template<typename T>
+       JsonValue & emplace(std::string key, T && value) const
+       {
+           invalidate();
+           return map->try_emplace(std::move(key), std::forward<T>(value)).first->second;
+       }
        void remove(const std::string & key);
        void clear();
        JsonValue & operator [](const std::string & key) const;
@@ -139,47 +290,155 @@ public:
        operator Map &();
 
        void setMap(const Map & map);
+       void setMap(Map && map);
        Object & operator = (const Map & map);
+       Object & operator = (Map && map);
 
      private:
-       std::shared_ptr<Map> map = std::make_shared<Map>();
+       struct Node;
+       std::shared_ptr<Map> map;
+       std::shared_ptr<Slot> slot; //shares the allocation of map
+
+       //const accessors of snapshots run it on several threads, only the thread taking the fragment frees it
+       void invalidate() const
+       {
+           if(slot->cache.load(std::memory_order_relaxed) != nullptr) delete slot->cache.exchange(nullptr);
+           if(slot->hashed.load(std::memory_order_relaxed) != 0) forgetHash(*slot);
+       }
+       bool shared() const { return map.use_count() > 2; } //map and slot of one handle hold two references
     };
 
     class Array final
     {
+       friend class JsonValue;
        friend class JsonReader;
        friend class JsonWriter;
 
      public:
-       using Vector = std::vector<JsonValue>;
+       using Vector = std::pmr::vector<JsonValue>;
+       using Path = std::vector<std::string>; //keys of nested objects
        explicit Array();
        Array(const Vector & array);
+       Array(Vector && array);
        Array copy() const;
 
        std::size_t count() const;
        JsonValue & at(std::size_t index) const;
-       void append(const JsonValue & value);
+       void append(JsonValue value);
+       template<typename... Args>
+       JsonValue & emplace(Args &&... args)
+       {
+           invalidate();
+           JsonValue & ret = array->emplace_back(std::forward<Args>(args)...);
+           if(slot->indexes) indexLast();
+           return ret;
+       }
        void clear();
        JsonValue & operator[](std::size_t index) const;
 
+       //Hash index of the items by their scalar value at a path, items without one are skipped.
+       //index() builds the index of a path, append and emplace keep it up to date, other changes of
+       //the vector leave it stale until the next index(). Lookups only read: without an up to date
+       //index they scan the items. Changes inside the items are not tracked: index() rebuilds the
+       //index after them. Keys compare by type, 1 and 1.0 differ.
+       void index(const Path & path);
+       void dropIndex(const Path & path);
+       bool hasIndex(const Path & path) const;
+       JsonValue * lookup(const Path & path, const JsonValue & key) const; //first item, nullptr - none
+       std::vector<std::size_t> lookupAll(const Path & path, const JsonValue & key) const; //ascending positions
+
        const Vector & getVector() const;
        Vector & getVector();
        operator const Vector &() const;
        operator Vector &();
 
        void setVector(const Vector & vector);
+       void setVector(Vector && vector);
        Array & operator = (const Vector & vector);
+       Array & operator = (Vector && vector);
 
      private:
-       std::shared_ptr<Vector> array = std::make_shared<Vector>();
+       struct Node;
+       std::shared_ptr<Vector> array;
+       std::shared_ptr<Slot> slot; //shares the allocation of array
+
+       void invalidate() const
+       {
+           if(slot->cache.load(std::memory_order_relaxed) != nullptr) delete slot->cache.exchange(nullptr);
+           if(slot->hashed.load(std::memory_order_relaxed) != 0) forgetHash(*slot);
+       }
+       void reshape(); //the vector itself changed, indexes are stale until index()
+       bool shared() const { return array.use_count() > 2; }
+
+       Index & addIndex(const Path & path); //existing or a new stale one
+       const Index * findIndex(const Path & path) const; //nullptr - none or stale
+       void indexLast();
     };
 
-    using Value = std::variant<std::monostate, Object, Array, std::string, double, long long, bool, std::nullptr_t>;
+    //Already serialized json value, JsonWriter copies it as is
+    struct Raw
+    {
+       std::string json;
+    };
+
+    using Value = std::variant<std::monostate, Object, Array, std::string, double, long long, bool, std::nullptr_t, Raw>;
 
 private:
-    std::shared_ptr<Value> value = std::make_shared<Value>();
+    //Array::index: positions of the items by their value at a path
+    using IndexKey = std::variant<std::nullptr_t, std::string, double, long long, bool>;
+    struct Index
+    {
+       Array::Path path;
+       std::unordered_multimap<IndexKey, std::size_t> positions;
+       bool stale = false;
+    };
+
+    //Data of a container kept next to its map or vector
+    struct Slot
+    {
+       Cache cache = nullptr; //reset by every mutable access
+       std::weak_ptr<Value> parent; //value holding the container, set by link() and JsonReader
+       std::unique_ptr<std::vector<Index>> indexes; //arrays only
+       std::size_t hash = 0; //hash(true) of the container
+       std::atomic<std::uint64_t> hashed = 0; //hash epoch of hash, 0 - none
+
+       ~Slot(){ delete cache.load(); }
+       bool memoized() const { return hashed.load(std::memory_order_acquire) == hashEpoch.load(std::memory_order_acquire); }
+    };
+
+    //Memoized hashes of the ancestors include the hash of a container and a container does not know
+    //its ancestors: a change of a container with a memoized hash starts a new epoch, the hashes
+    //memoized in earlier epochs are dropped in every tree
+    static std::atomic<std::uint64_t> hashEpoch;
+    static void forgetHash(Slot & slot);
+
+    std::shared_ptr<Value> value = makeShell();
+
+    static std::shared_ptr<Value> makeShell();
+
+    JsonValue & detach();
+    static Slot * slotOf(const Value & value); //nullptr - not a container
+    static bool indexKey(const JsonValue & item, const Array::Path & path, IndexKey & key);
+    static bool scalarEqual(const Value & first, const Value & second);
+    static bool equal(const Value & first, const Value & second);
 
 public:
+    //Value shells, objects and arrays (with their maps and vectors) created on this thread while the
+    //scope lives are allocated from the resource, nullptr - the global allocator. Keys and strings use
+    //the global allocator. The resource must outlive every value allocated from it, scopes nest.
+    class MemoryScope final
+    {
+        std::pmr::memory_resource * previous;
+
+    public:
+        explicit MemoryScope(std::pmr::memory_resource * resource);
+        ~MemoryScope();
+        MemoryScope(const MemoryScope &) = delete;
+        MemoryScope & operator = (const MemoryScope &) = delete;
+    };
+
+    static std::pmr::memory_resource * memoryResource(); //of this thread, nullptr - the global allocator
+
     explicit JsonValue();
     JsonValue(const Object & object);
     JsonValue(const Array & array);
@@ -188,6 +447,7 @@ public:
     JsonValue(const char * string);
     JsonValue(std::string_view string);
     JsonValue(const std::string & string);
+    JsonValue(std::string && string);
 
     JsonValue(float val);
     JsonValue(double val);
@@ -201,18 +461,62 @@ public:
 
     JsonValue(bool val);
     JsonValue(std::nullptr_t);
+    JsonValue(const Raw & raw);
+    JsonValue(Raw && raw);
 
     JsonValue copy() const;
+    //Deep copy, subtrees shared inside the tree (and cycles) stay shared in the copy
+    JsonValue clone() const;
+
+    //Copy-on-write: a snapshot shares the whole tree in O(1) and keeps its contents while the tree
+    //is changed through edit(), which copies every container on the way that is shared with a snapshot.
+    //Other mutable accessors change shared containers in place, Object and Array handles taken
+    //before an edit may keep the old contents.
+    JsonValue snapshot() const;
+    Object & editObject(); //not an object - replaced with an empty object
+    Array & editArray();   //not an array - replaced with an empty array
+    JsonValue & edit(const std::string & key);
+    JsonValue & edit(std::size_t index); //std::out_of_range as Array::at
+
+    //Parent links: an object or array links to the value holding it without owning it. JsonReader
+    //sets the links with setParentLinks(true), link() sets them below a value built through the API.
+    //Edits do not update the links, a container held by several containers links to one of them.
+    void link() const;
+    JsonValue parent() const; //empty - a scalar, no link or the parent is gone
+    std::vector<JsonValue> ancestors() const; //nearest first
+    JsonValue resolve(const std::string & key) const; //value of the key in this object or in the nearest ancestor object having it
+
+    //Tree search without recursion: this value and every value below it, a container reached twice
+    //(shared subtrees, cycles) is entered once. key - key in the parent object, empty for array
+    //items and this value, depth - 0 for this value. The visitor returns false to stop the search,
+    //the tree must not be changed during the search.
+    using Visitor = std::function<bool(const JsonValue & value, const std::string & key, std::size_t depth)>;
+    void search(const Visitor & visitor, JsonSearch order = JsonSearch::DepthFirst) const;
+    std::vector<JsonValue> find(const std::string & key, JsonSearch order = JsonSearch::DepthFirst) const; //values of the key at any depth
+    std::vector<JsonValue> find(const std::function<bool(const JsonValue &)> & predicate, JsonSearch order = JsonSearch::DepthFirst) const;
 
     JsonType type() const;
     bool isEmpty() const;
 
+    //Structural hash: objects by their pairs in key order (the insertion order does not matter),
+    //numbers with their type (1 and 1.0 differ, as for the array indexes). memoize - keep the hash
+    //in every container until a container holding a kept hash is changed through a mutable accessor
+    //(also through a nested handle), which drops the kept hashes of every tree; every call reads
+    //the kept hashes, only memoizing calls write them and need the tree to themselves.
+    //The tree must be acyclic.
+    std::size_t hash(bool memoize = false) const;
+    //Deep equality consistent with hash(), stops at shared containers, different sizes or memoized
+    //hashes and at the first difference
+    bool operator==(const JsonValue & other) const;
+
     const Value & getValue() const;
     Value & getValue();
     operator const Value &() const;
     operator Value &();
     void setValue(const Value & value);
+    void setValue(Value && value);
     JsonValue & operator = (const Value & value);
+    JsonValue & operator = (Value && value);
 
     Object getObject() const;
     void setObject(const Object & object);
@@ -229,11 +533,13 @@ public:
     void setString(const char * string);
     void setString(std::string_view string);
     void setString(const std::string & string);
+    void setString(std::string && string);
     operator std::string() const;
     JsonValue & operator = (char c);
     JsonValue & operator = (const char * string);
     JsonValue & operator = (std::string_view string);
     JsonValue & operator = (const std::string & string);
+    JsonValue & operator = (std::string && string);
 
     double getDouble() const;
     void setDouble(float val);
@@ -265,25 +571,105 @@ public:
     bool getNull() const;
     void setNull();
     JsonValue & operator = (std::nullptr_t);
+
+    Raw getRaw() const;
+    void setRaw(const Raw & raw);
+    void setRaw(Raw && raw);
+    JsonValue & operator = (const Raw & raw);
+    JsonValue & operator = (Raw && raw);
+};
+
+//Keys of unordered containers, hashed without memoizing
+template<>
+struct std::hash<JsonValue>
+{
+    std::size_t operator()(const JsonValue & value) const { return value.hash(); }
 };
 
 class JsonReader final : public JsonSAXReader
 {
+    friend class JsonSAXParser; //static dispatch of the callbacks
+
+public:
+    //Non-owning reference to a result callback: lambdas are called without std::function
+    //wrapping, the callable must outlive the parse call. Function pointers are kept by value.
+    class Callback final
+    {
+        using Function = std::function<bool(JsonValue &)>;
+        using Pointer = bool (*)(JsonValue &);
+
+        void * object = nullptr;
+        Pointer pointer = nullptr;
+        bool (*function)(const Callback &, JsonValue &) = nullptr;
+
+    public:
+        Callback(){}
+        Callback(const Function & callback)
+        {
+            if(!callback) return;
+            object = const_cast<Function *>(&callback);
+            function = [](const Callback & self, JsonValue & value) -> bool { return (*static_cast<Function *>(self.object))(value); };
+        }
+
+        Callback(Pointer callback)
+        {
+            if(callback == nullptr) return;
+            pointer = callback;
+            function = [](const Callback & self, JsonValue & value) -> bool { return self.pointer(value); };
+        }
+
+        template<typename T>
+        requires (std::is_invocable_r_v<bool, T &, JsonValue &> && !std::is_function_v<std::remove_reference_t<T>> && !std::is_pointer_v<std::remove_cvref_t<T>> &&
+                  !std::is_same_v<std::remove_cvref_t<T>, Function> && !std::is_same_v<std::remove_cvref_t<T>, Callback>)
+        Callback(T && callback)
+        {
+            object = const_cast<void *>(static_cast<const void *>(std::addressof(callback)));
+            function = [](const Callback & self, JsonValue & value) -> bool { return (*static_cast<std::remove_reference_t<T> *>(self.object))(value); };
+        }
+
+        explicit operator bool() const { return function != nullptr; }
+        bool operator()(JsonValue & value) const { return function(*this, value); }
+    };
+
+private:
     JsonValue root;
-    std::stack<std::shared_ptr<JsonValue::Value>> stack;
+    std::stack<std::shared_ptr<JsonValue::Value>, std::vector<std::shared_ptr<JsonValue::Value>>> stack;
     std::string key;
-    std::function<bool(JsonValue &)> callback;
+    Callback callback;
+
+    std::unordered_set<std::string> rawKeys;
+    JsonBufferReader * source = nullptr;
+    bool rawInput = false;
+    bool parentLinks = false;
+    std::unordered_map<std::string, JsonValue::Array::Path> indexKeys;
+    std::pmr::memory_resource * resource = nullptr;
+    std::size_t rawLevel = 0; //nesting inside the container kept raw, 0 - none
+    std::size_t rawStart = 0;
+
+    bool beginRaw();
+    void endRaw();
 
-    void insertValue(JsonValue & value);
+    void insertValue(JsonValue && value);
 
 public:
     explicit JsonReader();
-    bool parse(JsonBufferReader & buffer, const std::function<bool (JsonValue &)> &resultCallback, Operation operation = Single);
-    bool parse(std::string_view json, const std::function<bool(JsonValue &)> & resultCallback, Operation operation = Single);
-    JsonValue parse(JsonBufferReader & buffer);
-    JsonValue parse(std::string_view json);
-    bool parseFromFile(const std::string & fileName, const std::function<bool(JsonValue &)> & resultCallback, Operation operation = Single);
-    JsonValue parseFromFile(const std::string & fileName);
+
+    //Object and array values of these keys are kept as JsonValue::Raw text without building nodes.
+    //Text format only, the reader must return earlier input (JsonBufferReader::copy).
+    void setRawKeys(const std::unordered_set<std::string> & keys);
+    //Objects and arrays get parent links (JsonValue::parent), off by default
+    void setParentLinks(bool links);
+    //Arrays that are values of these keys get an index on the path (JsonValue::Array::index)
+    void setIndexKeys(const std::unordered_map<std::string, JsonValue::Array::Path> & keys);
+    //Trees are built in a JsonValue::MemoryScope of the resource, nullptr - the scope of the caller
+    void setMemoryResource(std::pmr::memory_resource * resource);
+
+    bool parse(JsonBufferReader & buffer, Callback resultCallback, Operation operation = Single, JsonFormat format = JsonFormat::Text);
+    bool parse(std::string_view json, Callback resultCallback, Operation operation = Single, JsonFormat format = JsonFormat::Text);
+    JsonValue parse(JsonBufferReader & buffer, JsonFormat format = JsonFormat::Text);
+    JsonValue parse(std::string_view json, JsonFormat format = JsonFormat::Text);
+    bool parseFromFile(const std::string & fileName, Callback resultCallback, Operation operation = Single, JsonFormat format = JsonFormat::Text);
+    JsonValue parseFromFile(const std::string & fileName, JsonFormat format = JsonFormat::Text);
 
 private:
     void JsonBegin() override;
@@ -310,6 +696,9 @@ public:
     virtual ~JsonBufferWriter(){}
 
     virtual bool write(unsigned char ch) = 0;
+    virtual bool writeData(std::string_view data){ for(unsigned char ch : data){ if(!write(ch)) return false; } return true; }
+    //data stays valid until the buffer content is consumed and may be referenced instead of copied
+    virtual bool writeReference(std::string_view data){ return writeData(data); }
     virtual std::size_t writeCount() = 0;
 };
 
@@ -321,8 +710,10 @@ class JsonStringBufferWriter : public JsonBufferWriter
 public:
     explicit JsonStringBufferWriter();
     bool write(unsigned char ch) override;
+    bool writeData(std::string_view data) override;
     std::size_t writeCount() override;
     const std::string & result() const;
+    void reserve(std::size_t size);
 };
 
 class JsonFileBufferWriter : public JsonBufferWriter
@@ -336,12 +727,70 @@ public:
     bool open(const std::string & fileName);
     bool isOpen();
     bool write(unsigned char ch) override;
+    bool writeData(std::string_view data) override;
     std::size_t writeCount() override;
 };
 
+//Fixed-size blocks reused by JsonChainBufferWriter, not thread-safe
+class JsonBufferPool
+{
+    std::size_t _blockSize;
+    std::vector<std::unique_ptr<char[]>> blocks;
+
+public:
+    explicit JsonBufferPool(std::size_t blockSize = 16384);
+    std::size_t blockSize() const;
+    std::unique_ptr<char[]> take();
+    void give(std::unique_ptr<char[]> block);
+};
+
+//Output as a chain of pooled blocks and referenced strings, ready for writev/sendmsg
+//(send in batches of IOV_MAX segments). Referenced strings must outlive the segments.
+class JsonChainBufferWriter : public JsonBufferWriter
+{
+    JsonBufferPool ownPool;
+    JsonBufferPool * pool;
+    std::size_t referenceSize;
+    std::size_t count = 0;
+    std::size_t used = 0; //bytes used in the last block
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<JsonSegment> _segments;
+
+public:
+    explicit JsonChainBufferWriter(JsonBufferPool * pool = nullptr, std::size_t referenceSize = 4096);
+    ~JsonChainBufferWriter() override;
+
+    bool write(unsigned char ch) override;
+    bool writeData(std::string_view data) override;
+    bool writeReference(std::string_view data) override;
+    std::size_t writeCount() override;
+
+    const std::vector<JsonSegment> & segments() const;
+    void clear();
+};
+
 class JsonSAXWriter
 {
+public:
+    static constexpr std::size_t UnknownSize = static_cast<std::size_t>(-1);
+
+    //Pretty printing (beautiful = true)
+    struct Style
+    {
+        std::size_t indent = 2;     //characters per level
+        bool tabs = false;          //indent with tabs instead of spaces
+        bool compactArrays = false; //JsonWriter: arrays of scalars on a single line
+    };
+
+private:
+    static constexpr std::size_t IndentRun = 64;
+
     bool beautiful = false;
+    bool stableStrings = false;
+    Style _style;
+    std::string indent;             //'\n' and a run of indentation written in one call
+    std::size_t inlineLevel = 0;    //level of the array written on a single line, 0 - none
+    JsonFormat format = JsonFormat::Text;
     std::string _error;
     JsonBufferWriter * buffer = nullptr;
 
@@ -351,33 +800,84 @@ class JsonSAXWriter
         ObjectKey,
         ObjectNextPair,
         Array,
-        ArrayNextValue
+        ArrayNextValue,
+        Fragment
     };
 
     std::stack<Сondition> stack;
 
+    //Binary formats (MessagePack, CBOR)
+    struct BinaryFrame
+    {
+        std::size_t size;   //declared items (pairs for object), UnknownSize - not declared
+        std::size_t count;  //written items
+        std::size_t offset; //MessagePack: body start in pending buffer
+        bool object;
+        bool key;           //object: key written, value expected
+    };
+
+    std::stack<BinaryFrame> frames;
+    std::string pending;    //MessagePack: containers of unknown size are collected here until the end
+    std::size_t pendingDepth = 0;
+
+    //Canonical text (RFC 8785): Text format with its own numbers and escaping
+    bool canonical = false;
+    std::vector<std::string> canonicalKeys; //last key of the object open at each level
+
+    bool writeByte(unsigned char ch);
+    bool writeBigEndian(std::uint64_t value, std::size_t size);
+    bool writeHeader(unsigned char major, std::uint64_t value);
+    bool binaryItem(bool key, bool container);
+    bool binaryBegin(bool object, std::size_t size);
+    bool binaryEnd(bool object);
+    bool binaryString(const std::string & string);
+    bool binaryInteger(long long value);
+
     bool checkBuffer();
     bool writeChar(unsigned char ch);
-    bool writeSpace(int count);
+    bool writeData(std::string_view data);
+    bool writeIndent(std::size_t level, bool newline);
+    bool isInline() const;
+    bool writeNextLine();
     bool checkCorrectValue();
     bool containerEnd();
     bool checkIsNotObject();
-    bool checkIsObject(bool key, bool end);
+    bool checkIsObject();
     bool writeString(const std::string & string);
+    bool writeStringData(std::string_view data);
+    bool writeCanonicalNumber(double value);
 
 protected:
+    JsonStats _stats;
+
     void setError(const std::string & error);
+    //Strings passed to the writer outlive the buffer content (JsonWriter tree values)
+    void setStableStrings(bool stable);
+    bool isCanonical() const;
+
+    //Text of a whole container written as is (text format only): FragmentBegin writes the separator
+    //in front of it, containers and values written before FragmentEnd get no separators of their own
+    bool FragmentBegin();
+    bool FragmentData(std::string_view data);
+    bool FragmentEnd();
 
 public:
     explicit JsonSAXWriter();
     std::string error() const;
     void setBuffer(JsonBufferWriter * buffer, bool beautiful = false);
-
-    bool ObjectBegin();
+    void setBuffer(JsonBufferWriter * buffer, JsonFormat format);
+    void setStyle(const Style & style);
+    Style style() const;
+
+    //size - number of pairs/values, required by definite-length binary containers.
+    //Canonical output: keys must come in UTF-16 order, strings must be valid UTF-8, numbers finite,
+    //integers beyond 2^53 are written as the doubles nearest to them, Raw values are rejected.
+    bool ObjectBegin(std::size_t size = UnknownSize);
     bool ObjectKey(const std::string & key);
     bool ObjectEnd();
 
-    bool ArrayBegin();
+    //compact - with beautiful output write the array on a single line
+    bool ArrayBegin(std::size_t size = UnknownSize, bool compact = false);
     bool ArrayEnd();
 
     bool Value(const std::string & value);
@@ -385,17 +885,245 @@ public:
     bool Value(long long value);
     bool Value(bool value);
     bool Null();
+
+    //Already serialized json value written as is (text format only)
+    bool Raw(std::string_view json);
+
+    const JsonStats & stats() const;
+    void resetStats();
 };
 
 class JsonWriter final : public JsonSAXWriter
 {
-    bool writeValue(JsonValue & value);
+    static constexpr std::size_t Unordered = static_cast<std::size_t>(-1);
+
+    struct Frame
+    {
+        const JsonValue::Object::Map * map = nullptr;
+        JsonValue::Object::Map::const_iterator pos;
+        const JsonValue::Array::Vector * array = nullptr;
+        std::size_t index = 0;
+        const JsonValue::Fragment * fragment = nullptr; //cached text being spliced in
+        std::size_t piece = 0;                          //fragment: text written so far
+        std::size_t hole = 0;                           //fragment: next child container
+        JsonValue::Cache * cache = nullptr;             //encoded container: slot for its text
+        std::size_t start = 0;                          //container text offset in the record
+        std::size_t spliced = 0;                        //first child range in spliced
+        const JsonValue::Object::Map * patch = nullptr; //merge patch of map, joined with it by key
+        JsonValue::Object::Map::const_iterator patchPos;
+        std::size_t order = Unordered;                  //canonical: first pair of map in ordered, index - next pair
+
+        const void * container() const
+        {
+            if(patch != nullptr) return patch;
+            return (map != nullptr) ? static_cast<const void *>(map) : static_cast<const void *>(array);
+        }
+    };
+
+    //The first ancestors are scanned in place, deeper ones are looked up in the hash set
+    static constexpr std::size_t LinearAncestors = 16;
+
+    //Forwards the output and keeps a copy of it while the cache is filled
+    class Recorder final : public JsonBufferWriter
+    {
+    public:
+        JsonBufferWriter * target = nullptr;
+        std::string text;
+        bool active = true;
+
+        bool write(unsigned char ch) override;
+        bool writeData(std::string_view data) override;
+        bool writeReference(std::string_view data) override;
+        std::size_t writeCount() override;
+    };
+
+    bool checkCycles = true;
+    bool caching = false;
+    std::pmr::vector<Frame> frames;
+    std::pmr::unordered_set<const void *> ancestors;
+    JsonValue::Fragment layout;
+    Recorder recorder;
+    std::pmr::vector<std::pair<std::size_t, std::size_t>> spliced; //record ranges of child containers
+    std::pmr::vector<const JsonValue::Object::Map::value_type *> ordered; //canonical: pairs of open maps in UTF-16 key order
+
+    bool isAncestor(const void * container) const;
+    bool enterContainer(const JsonValue & value);
+    bool enterMerged(const JsonValue * base, const JsonValue & patch); //base: nullptr or not an object - {}
+    bool writeFragment(Frame & frame, std::size_t end);
+    void storeFragment(const Frame & frame);
+    bool writeValue(const JsonValue & value);
+    bool writeTree(const JsonValue & json);
+    bool writeFrames();
+    bool writeTree(JsonBufferWriter & buffer, const JsonValue & json); //counts the output
+    bool writeMergedTree(JsonBufferWriter & buffer, const JsonValue & json, const JsonValue & patch);
 public:
     explicit JsonWriter();
+
+    //A container that is its own ancestor is written as null.
+    //Disable the check only for trees known to be acyclic.
+    void setCycleCheck(bool enabled);
+
+    //Keep the text of every written container and reuse it until the container is changed through
+    //Object::insert/remove/clear/operator[]/getMap/setMap or Array::at/append/clear/operator[]/getVector/setVector.
+    //Changes made through other handles sharing a value are not tracked. Text output only. Filling
+    //the cache writes into the tree: the writer must not run alongside other writers or changes of it.
+    void setCache(bool enabled);
+
+    //Traversal state (frames, ancestors, cache ranges) is allocated from the resource, nullptr - the global allocator
+    void setMemoryResource(std::pmr::memory_resource * resource);
+
+    //Exact size of the text output with the current style, 0 - not an object or an array
+    std::size_t size(const JsonValue & json, bool beautiful = false);
+
     bool write(JsonBufferWriter & buffer, const JsonValue & json, bool beautiful = false);
     bool write(std::string & string, const JsonValue & json, bool beautiful = false);
     std::string write(const JsonValue & json, bool beautiful = false);
     bool writeToFile(const std::string & fileName, const JsonValue & json, bool beautiful = false);
+
+    bool write(JsonBufferWriter & buffer, const JsonValue & json, JsonFormat format);
+    bool write(std::string & string, const JsonValue & json, JsonFormat format);
+    std::string write(const JsonValue & json, JsonFormat format);
+    bool writeToFile(const std::string & fileName, const JsonValue & json, JsonFormat format);
+
+    //RFC 7386 Merge Patch applied while json is written, the merged tree is never built: keys of
+    //each object are joined with the keys of its patch object. A patch that is not an object is
+    //written instead of json. The writer cache is not used.
+    bool writeMerged(JsonBufferWriter & buffer, const JsonValue & json, const JsonValue & patch, bool beautiful = false);
+    bool writeMerged(std::string & string, const JsonValue & json, const JsonValue & patch, bool beautiful = false);
+    bool writeMerged(JsonBufferWriter & buffer, const JsonValue & json, const JsonValue & patch, JsonFormat format);
+};
+
+//RFC 6902 JSON Patch applied in place through the copy-on-write edits: containers shared with
+//snapshots are copied on the way, values taken from the patch are shared with it as snapshots.
+//Operations under the same parent as the previous one reuse its resolved path.
+class JsonPatch final
+{
+    //Value at each level of the parent path of the last operation, [0] - the document
+    struct Step
+    {
+        JsonValue * value;
+        std::string token; //key or index of the value in the previous step
+    };
+
+    std::vector<Step> steps;
+    std::vector<std::string> path;
+    std::vector<std::string> from;
+    bool atomic = false;
+    std::string _error;
+
+    static bool parsePointer(const std::string & pointer, std::vector<std::string> & tokens);
+    static bool parseIndex(const std::string & token, std::size_t size, std::size_t & index); //index <= size
+    JsonValue * resolveParent(JsonValue & document, const std::vector<std::string> & tokens); //editable, nullptr - not found
+    const JsonValue * find(const JsonValue & document, const std::vector<std::string> & tokens) const;
+    bool add(JsonValue & document, const std::vector<std::string> & tokens, JsonValue value);
+    bool remove(JsonValue & document, const std::vector<std::string> & tokens, JsonValue * removed);
+    bool replace(JsonValue & document, const std::vector<std::string> & tokens, JsonValue value);
+    bool applyOperation(JsonValue & document, const JsonValue & operation, std::size_t index);
+    bool fail(const char * msg, std::size_t index);
+    //equal without a walk: one shell or container, equal scalars, equal memoized hashes confirmed by ==
+    static bool sameValue(const JsonValue::Value & first, const JsonValue::Value & second);
+
+public:
+    explicit JsonPatch();
+
+    //Operations are applied in order, the first failing one stops the patch. The document keeps the
+    //operations applied before it, in atomic mode it is restored from a snapshot taken before the patch.
+    bool apply(JsonValue & document, const JsonValue & patch);
+    void setAtomic(bool enabled);
+    std::string error() const;
+
+    //Numbers are equal by value (1 and 1.0), objects regardless of the key order
+    static bool equal(const JsonValue & first, const JsonValue & second);
+
+    //RFC 7386 Merge Patch: objects are merged key by key, null removes a key, other values replace
+    static void merge(JsonValue & document, const JsonValue & patch);
+
+    //JSON Patch turning source into target. Values sharing a shell or a container (snapshots and
+    //their edited copies) are skipped without a walk, arrays keep their common head and tail and
+    //only the items between them are compared one to one, added or removed.
+    static JsonValue diff(const JsonValue & source, const JsonValue & target);
+};
+
+//Read-only document: readers on any number of threads need no locks, lookups never insert,
+//never write the writer cache and do not touch reference counts
+class JsonDocument final
+{
+public:
+    //Value inside the document, valid while the document lives. Missing values are empty views.
+    class View final
+    {
+        const JsonValue::Value * value = nullptr;
+
+        //the containers stay inside: their values hand out mutable handles
+        const JsonValue::Object::Map * object() const; //nullptr - not an object
+        const JsonValue::Array::Vector * array() const; //nullptr - not an array
+
+    public:
+        View(){}
+        explicit View(const JsonValue::Value * value) : value(value){}
+
+        explicit operator bool() const { return value != nullptr; }
+        JsonType type() const;
+        std::size_t count() const; //pairs of an object, values of an array, 0 - other types
+
+        View operator[](const std::string & key) const;
+        View operator[](std::size_t index) const;
+        //Pairs of an object in key order or values of an array, key - empty for arrays.
+        //false from the callback stops the walk and is returned.
+        bool forEach(const std::function<bool(std::string_view key, View value)> & callback) const;
+
+        std::string_view getString() const;
+        double getDouble() const;
+        long long getLongLong() const;
+        bool getBool() const;
+        bool getNull() const;
+        std::string_view getRaw() const;
+    };
+
+private:
+    JsonValue _root;
+    std::string _error;
+
+public:
+    explicit JsonDocument();
+    explicit JsonDocument(const JsonValue & root); //deep copy, later changes of root are not seen
+
+    bool parse(std::string_view json, JsonFormat format = JsonFormat::Text);
+    bool parseFromFile(const std::string & fileName, JsonFormat format = JsonFormat::Text);
+    std::string error() const;
+
+    View root() const;
+    bool write(JsonBufferWriter & buffer, bool beautiful = false) const;
+    std::string write(bool beautiful = false) const;
+};
+
+//RCU-style publication: a writer swaps in a new document, every reader keeps the document it loaded
+//until it sees a newer version, old documents are freed when the last reader drops them
+class JsonPublisher final
+{
+    mutable std::mutex lock; //taken by publish and by readers reloading after a publish
+    std::shared_ptr<const JsonDocument> current;
+    std::atomic<std::uint64_t> _version = 0;
+
+public:
+    //One per reader thread: the hot path is a single atomic load of the version
+    class Reader final
+    {
+        const JsonPublisher * publisher;
+        std::shared_ptr<const JsonDocument> document;
+        std::uint64_t version = 0;
+
+    public:
+        explicit Reader(const JsonPublisher & publisher);
+        const JsonDocument & get();
+    };
+
+    explicit JsonPublisher();
+    explicit JsonPublisher(std::shared_ptr<const JsonDocument> document);
+
+    void publish(std::shared_ptr<const JsonDocument> document);
+    std::shared_ptr<const JsonDocument> load() const;
+    std::uint64_t version() const;
 };
 
 #endif // JSON_H
@@ -0,0 +1,1716 @@
+#ifndef JSON_SAX_PARSER_H
+#define JSON_SAX_PARSER_H
+
+#include "Json.h"
+#include "JsonStatsHooks.h"
+#include <charconv>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+//Definitions of JsonSAXParser::parse: the text tokenizer (JSON, JSON5) and the MessagePack and CBOR
+//readers. Include this header where parse() is called with a handler type, the handler callbacks
+//are then inlined into the tokenizer. Json.cpp instantiates it for JsonSAXReader and JsonReader.
+//Helpers of the parser are in the JsonSAXDetail namespace.
+
+enum class JsonReaderType : unsigned char
+{
+     Object = 0,
+     ObjectKey,
+     ObjectValue,
+     ObjectNextPair,
+     ObjectNextKey,
+
+     Array,
+     ArrayNext,
+     ArrayNextValue
+};
+
+namespace JsonSAXDetail
+{
+
+//The helpers compile differently with JSON_STATS, their names carry the setting: a translation unit
+//built without it does not share inline definitions with a library built with it
+#if defined(JSON_STATS)
+inline namespace Stats
+#else
+inline namespace NoStats
+#endif
+{
+
+constexpr bool isControlCode(unsigned char value){ return (value <= 8 || (value >= 14 && value <= 31) || value == 127); }
+
+//----------------------------------------------------------------
+
+inline const char * const ControlCharacterDetectionMsg = "Control character detection, offset: ",
+                  * const InvalidNumberMsg = "Invalid number, offset: ",
+                  * const ALotPointMsg = "A lot or an incorrect numeric point, offset: ",
+                  * const NumberRangeMsg = "Number out of range, offset: ",
+                  * const NumberOutOfArrayMsg = "Number out of array limit, offset: ",
+                  * const StringOutOfArrayMsg = "String out of array limit, offset: ",
+                  * const ValueOutOfArrayMsg = "Value out of array limit, offset: ",
+                  * const InvalidValueMsg = "Invalid value, offset: ",
+                  * const InvalidEntryCharacterMsg = "Invalid entry character '",
+                  * const InvalidObjectKeyMsg = "Invalid starting symbol of the object key or the end of an object '",
+                  * const InvalidObjectKeyValueMsg = "Invalid object key-value separator character '",
+                  * const InvalidSeparatorObjectMsg = "Invalid pair separator or end of object symbol, offset: ",
+                  * const InvalidSeparatorArrayMsg = "Invalid value separator or end of array symbol, offset: ",
+                  * const UnexpectedEndMsg = "Unexpected end of json stream",
+                  * const InvalidSpecialCharMsg = "Invalid special character in string '\\",
+                  * const InvalidUnicodeMsg = "Invalid unicode escape sequence, offset: ",
+                  * const InvalidCommentMsg = "Invalid or unterminated comment, offset: ",
+                  * const DepthLimitMsg = "Nesting depth limit exceeded, offset: ",
+                  * const TokenLimitMsg = "Token count limit exceeded, offset: ",
+                  * const StringLimitMsg = "String length limit exceeded, offset: ",
+                  * const SizeLimitMsg = "Document size limit exceeded, offset: ",
+                  * const OutOfMemoryMsg = "Out of memory, offset: ";
+
+inline std::string makeError(const char * msg, JsonBufferReader & buffer)
+{
+    return  msg + std::to_string(buffer.offset());
+}
+
+inline std::string makeError(const char * msg, unsigned char ch, JsonBufferReader & buffer)
+{
+    return std::string(msg) + static_cast<char>(ch) + "', offset: " + std::to_string(buffer.offset());
+}
+
+//----------------------------------------------------------------
+
+//Character classes and state transitions of the text tokenizer
+
+enum CharClass : unsigned char
+{
+     CharOther = 0,
+     CharSpace,
+     CharControl,
+     CharObjectBegin,
+     CharObjectEnd,
+     CharArrayBegin,
+     CharArrayEnd,
+     CharQuote,
+     CharColon,
+     CharComma,
+     CharNumber,
+     CharLiteral,
+     CharSlash,
+     CharClassCount
+};
+
+//JSON5 identifier: keys without quotes, Infinity and NaN
+constexpr bool isIdentifierStart(unsigned char ch){ return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' || ch == '$' || ch >= 0x80; }
+constexpr bool isIdentifierPart(unsigned char ch){ return isIdentifierStart(ch) || (ch >= '0' && ch <= '9'); }
+
+//json5 - classes of the JSON5 tokenizer: identifiers, '+' and '.' start numbers, single quotes, comments
+constexpr std::array<CharClass, 256> makeCharClasses(bool json5)
+{
+    std::array<CharClass, 256> table{};
+
+    for(int ch = 0; ch < 256; ch++)
+    {
+        if(isControlCode(static_cast<unsigned char>(ch))) table[ch] = CharControl;
+        else if(ch == ' ' || (ch >= '\t' && ch <= '\r')) table[ch] = CharSpace;
+        else if(ch == '-' || (ch >= '0' && ch <= '9')) table[ch] = CharNumber;
+    }
+
+    table['{'] = CharObjectBegin;
+    table['}'] = CharObjectEnd;
+    table['['] = CharArrayBegin;
+    table[']'] = CharArrayEnd;
+    table['"'] = CharQuote;
+    table[':'] = CharColon;
+    table[','] = CharComma;
+    table['t'] = CharLiteral;
+    table['f'] = CharLiteral;
+    table['n'] = CharLiteral;
+
+    if(json5)
+    {
+       for(int ch = 0; ch < 256; ch++)
+       {
+           if(isIdentifierStart(static_cast<unsigned char>(ch))) table[ch] = CharLiteral;
+       }
+
+       table['+'] = CharNumber;
+       table['.'] = CharNumber;
+       table['\''] = CharQuote;
+       table['/'] = CharSlash;
+    }
+
+    return table;
+}
+
+inline constexpr std::array<CharClass, 256> charClasses = makeCharClasses(false);
+inline constexpr std::array<CharClass, 256> charClasses5 = makeCharClasses(true);
+
+enum Action : unsigned char
+{
+     ActionError = 0,
+     ActionColon,
+     ActionNextPair,
+     ActionObjectEnd,
+     ActionNextValue,
+     ActionArrayEnd,
+     ActionComment,
+
+     ActionRootObject, //actions from here on start a token
+     ActionRootArray,
+     ActionKey,
+     ActionIdentifierKey,
+     ActionObject,
+     ActionArray,
+     ActionString,
+     ActionNumber,
+     ActionLiteral,
+     ActionCount
+};
+
+constexpr std::size_t RootState = static_cast<std::size_t>(JsonReaderType::ArrayNextValue) + 1;
+using TransitionTable = std::array<std::array<Action, CharClassCount>, RootState + 1>;
+
+constexpr TransitionTable makeTransitions(bool json5)
+{
+    TransitionTable table{};
+
+    auto values = [&table](JsonReaderType state)
+    {
+        auto & row = table[static_cast<std::size_t>(state)];
+        row[CharObjectBegin] = ActionObject;
+        row[CharArrayBegin] = ActionArray;
+        row[CharQuote] = ActionString;
+        row[CharNumber] = ActionNumber;
+        row[CharLiteral] = ActionLiteral;
+    };
+
+    table[RootState][CharObjectBegin] = ActionRootObject;
+    table[RootState][CharArrayBegin] = ActionRootArray;
+
+    table[static_cast<std::size_t>(JsonReaderType::Object)][CharQuote] = ActionKey;
+    table[static_cast<std::size_t>(JsonReaderType::Object)][CharObjectEnd] = ActionObjectEnd;
+    table[static_cast<std::size_t>(JsonReaderType::ObjectKey)][CharColon] = ActionColon;
+    values(JsonReaderType::ObjectValue);
+    table[static_cast<std::size_t>(JsonReaderType::ObjectNextPair)][CharComma] = ActionNextPair;
+    table[static_cast<std::size_t>(JsonReaderType::ObjectNextPair)][CharObjectEnd] = ActionObjectEnd;
+    table[static_cast<std::size_t>(JsonReaderType::ObjectNextKey)][CharQuote] = ActionKey;
+
+    values(JsonReaderType::Array);
+    table[static_cast<std::size_t>(JsonReaderType::Array)][CharArrayEnd] = ActionArrayEnd;
+    table[static_cast<std::size_t>(JsonReaderType::ArrayNext)][CharComma] = ActionNextValue;
+    table[static_cast<std::size_t>(JsonReaderType::ArrayNext)][CharArrayEnd] = ActionArrayEnd;
+    values(JsonReaderType::ArrayNextValue);
+
+    //JSON5: comments between tokens, keys without quotes, trailing commas
+    if(json5)
+    {
+       for(auto & row : table) row[CharSlash] = ActionComment;
+
+       table[static_cast<std::size_t>(JsonReaderType::Object)][CharLiteral] = ActionIdentifierKey;
+       table[static_cast<std::size_t>(JsonReaderType::ObjectNextKey)][CharLiteral] = ActionIdentifierKey;
+       table[static_cast<std::size_t>(JsonReaderType::ObjectNextKey)][CharObjectEnd] = ActionObjectEnd;
+       table[static_cast<std::size_t>(JsonReaderType::ArrayNextValue)][CharArrayEnd] = ActionArrayEnd;
+    }
+
+    return table;
+}
+
+inline constexpr TransitionTable transitions = makeTransitions(false);
+inline constexpr TransitionTable transitions5 = makeTransitions(true);
+
+inline std::string makeStateError(std::size_t state, unsigned char ch, JsonBufferReader & buffer)
+{
+    if(state == RootState) return makeError(InvalidEntryCharacterMsg, ch, buffer);
+
+    switch(static_cast<JsonReaderType>(state))
+    {
+       case JsonReaderType::Object:
+       case JsonReaderType::ObjectNextKey: return makeError(InvalidObjectKeyMsg, ch, buffer);
+       case JsonReaderType::ObjectKey: return makeError(InvalidObjectKeyValueMsg, ch, buffer);
+       case JsonReaderType::ObjectNextPair: return makeError(InvalidSeparatorObjectMsg, buffer);
+       case JsonReaderType::ArrayNext: return makeError(InvalidSeparatorArrayMsg, buffer);
+       default: return makeError(InvalidValueMsg, buffer);
+    }
+}
+
+//Byte budget of a document: bytes a token may read after its first one, every byte read spends one
+inline bool spendByte(std::size_t & budget, JsonBufferReader & buffer, std::string & error)
+{
+    if(budget-- > 0) [[likely]] return true;
+    error = makeError(SizeLimitMsg, buffer);
+    return false;
+}
+
+inline bool spendBytes(std::size_t & budget, std::uint64_t count, JsonBufferReader & buffer, std::string & error)
+{
+    if(count <= budget)
+    {
+       budget -= count;
+       return true;
+    }
+
+    error = makeError(SizeLimitMsg, buffer);
+    return false;
+}
+
+//Hex digits of a \u (four) or a JSON5 \x (two) escape sequence
+inline bool readyHex(unsigned int & code, JsonBufferReader & buffer, int digits = 4)
+{
+    code = 0;
+    for(int i = 0; i < digits; i++)
+    {
+        if(!buffer.next()) return false;
+        const unsigned char ch = buffer.value();
+        code <<= 4;
+
+        if(ch >= '0' && ch <= '9') code |= ch - '0';
+        else if(ch >= 'a' && ch <= 'f') code |= ch - 'a' + 10;
+        else if(ch >= 'A' && ch <= 'F') code |= ch - 'A' + 10;
+        else return false;
+    }
+
+    return true;
+}
+
+inline void appendUtf8(std::string & temp, unsigned int code)
+{
+    if(code < 0x80)
+    {
+       temp.push_back(static_cast<char>(code));
+    }
+    else if(code < 0x800)
+    {
+       temp.push_back(static_cast<char>(0xc0 | (code >> 6)));
+       temp.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+    else if(code < 0x10000)
+    {
+       temp.push_back(static_cast<char>(0xe0 | (code >> 12)));
+       temp.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+       temp.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+    else
+    {
+       temp.push_back(static_cast<char>(0xf0 | (code >> 18)));
+       temp.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+       temp.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+       temp.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+}
+
+//JSON5 escape sequences beyond JSON: \' \v \0 \xHH, line continuations, other characters stand for themselves
+inline bool readyEscape5(unsigned char ch, std::string & temp, bool & lineBreak, std::size_t & budget, JsonBufferReader & buffer, std::string & error)
+{
+    switch(ch)
+    {
+       case 'v': temp.push_back('\v');
+       return true;
+       case '0': temp.push_back('\0');
+       return true;
+       case 'x':
+       {
+          unsigned int code;
+          if(!spendBytes(budget, 2, buffer, error)) return false;
+
+          if(!readyHex(code, buffer, 2))
+          {
+             error = makeError(InvalidUnicodeMsg, buffer);
+             return false;
+          }
+
+          appendUtf8(temp, code);
+       }
+       return true;
+       case '\r': lineBreak = true;
+       return true;
+       case '\n': return true;
+       default: break;
+    }
+
+    if(ch >= '1' && ch <= '9')
+    {
+       error =  makeError(InvalidSpecialCharMsg, ch, buffer);
+       return false;
+    }
+
+    temp.push_back(ch);
+    return true;
+}
+
+//quote - the opening quote, JSON5 strings may be in single quotes
+template<bool Json5>
+inline bool readyString(std::string & temp, unsigned char quote, std::size_t maxSize, std::size_t budget, JsonBufferReader & buffer, std::string & error, [[maybe_unused]] JsonStats & stats)
+{
+    bool exit = false, special = false;
+    [[maybe_unused]] bool lineBreak = false; //JSON5: '\r' of a line continuation, '\n' after it is skipped
+    if constexpr(!Json5) quote = '"';
+
+    while(buffer.next())
+    {
+          if(!spendByte(budget, buffer, error)) return false;
+          const unsigned char ch = buffer.value();
+
+          if constexpr(Json5)
+          {
+             if(lineBreak)
+             {
+                lineBreak = false;
+                if(ch == '\n') continue;
+             }
+          }
+
+          if(isControlCode(ch) && ch != 127) //DEL is a character in strings (RFC 8259)
+          {
+             error =  makeError(ControlCharacterDetectionMsg, buffer);
+             return false;
+          }
+
+          if(temp.size() > maxSize)
+          {
+             error = makeError(StringLimitMsg, buffer);
+             return false;
+          }
+
+          if(!special && ch == quote)
+          {
+             exit = true;
+             break;
+          }
+
+          if(!special && ch == '\\')
+          {
+             JSON_STAT(stats.escapes++);
+             special = true;
+             continue;
+          }
+
+          if(special)
+          {
+             switch (ch)
+             {
+                case '"':
+                case '\\':
+                case '/': temp.push_back(ch);
+                break;
+                case 'b': temp.push_back('\b');
+                break;
+                case 'f': temp.push_back('\f');
+                break;
+                case 'n': temp.push_back('\n');
+                break;
+                case 'r': temp.push_back('\r');
+                break;
+                case 't': temp.push_back('\t');
+                break;
+                case 'u':
+                {
+                     unsigned int code, low;
+                     if(!spendBytes(budget, 4, buffer, error)) return false;
+
+                     if(!readyHex(code, buffer) || (code >= 0xdc00 && code <= 0xdfff))
+                     {
+                        error = makeError(InvalidUnicodeMsg, buffer);
+                        return false;
+                     }
+
+                     //High surrogate, the low one follows as the next escape sequence
+                     if(code >= 0xd800 && code <= 0xdbff)
+                     {
+                        if(!spendBytes(budget, 6, buffer, error)) return false;
+
+                        if(!buffer.next() || buffer.value() != '\\' || !buffer.next() || buffer.value() != 'u' ||
+                           !readyHex(low, buffer) || low < 0xdc00 || low > 0xdfff)
+                        {
+                           error = makeError(InvalidUnicodeMsg, buffer);
+                           return false;
+                        }
+
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                     }
+
+                     appendUtf8(temp, code);
+                }
+                break;
+                default:
+                {
+                     if constexpr(Json5)
+                     {
+                        if(!readyEscape5(ch, temp, lineBreak, budget, buffer, error)) return false;
+                        break;
+                     }
+
+                     error =  makeError(InvalidSpecialCharMsg, ch, buffer);
+                     return false;
+                }
+             }
+
+             special = false;
+             continue;
+          }
+
+          temp.push_back(ch);
+    }
+
+    if(!exit)
+    {
+       error =  makeError(StringOutOfArrayMsg, buffer);
+       return false;
+    }
+
+    if(temp.size() > maxSize)
+    {
+       error = makeError(StringLimitMsg, buffer);
+       return false;
+    }
+
+    JSON_STAT(stats.stringBytes += temp.size());
+    return true;
+}
+
+template<bool Json5, typename Handler>
+inline bool readyObjectKey(std::string & temp, unsigned char quote, std::size_t maxSize, std::size_t budget, Handler & handler, JsonBufferReader & buffer, std::string & error, JsonStats & stats)
+{
+    temp.clear();
+    JSON_STAT(const std::size_t capacity = temp.capacity(); const std::uint64_t begin = statsClock());
+    if(!readyString<Json5>(temp, quote, maxSize, budget, buffer, error, stats)) return false;
+    JSON_STAT(stats.keys++; stats.stringCycles += statsClock() - begin; stats.allocations += (temp.capacity() != capacity));
+    JSON_TIMED(stats.handlerCycles, handler.ObjectKey(temp));
+    return true;
+}
+
+template<bool Json5, typename Handler>
+inline bool readyStringValue(std::string & temp, unsigned char quote, std::size_t maxSize, std::size_t budget, Handler & handler, JsonBufferReader & buffer, std::string & error, JsonStats & stats)
+{
+    temp.clear();
+    JSON_STAT(const std::size_t capacity = temp.capacity(); const std::uint64_t begin = statsClock());
+    if(!readyString<Json5>(temp, quote, maxSize, budget, buffer, error, stats)) return false;
+    JSON_STAT(stats.strings++; stats.stringCycles += statsClock() - begin; stats.allocations += (temp.capacity() != capacity));
+    JSON_TIMED(stats.handlerCycles, handler.Value(temp));
+    return true;
+}
+
+//The character that ends the number stays in the buffer and is processed by the tokenizer. Any number
+//of digits is read, std::from_chars rounds to the nearest double, beyond its range - a range error.
+template<typename Handler>
+inline bool readyNumber(const unsigned char digit, std::string & temp, std::size_t budget, Handler & handler, JsonBufferReader & buffer, std::string & error, [[maybe_unused]] JsonStats & stats)
+{
+    JSON_STAT(const std::uint64_t begin = statsClock());
+    int points = 0;
+    std::size_t exponent = 0, exponentDigits = 0; //exponent - position of 'e' in temp, 0 - none
+    const bool neg = (digit == '-');
+    bool exit = false;
+
+    temp.clear();
+    temp.push_back(digit);
+
+    unsigned char ch;
+    while(buffer.next())
+    {
+        if(!spendByte(budget, buffer, error)) return false;
+        ch = buffer.value();
+        const CharClass type = charClasses[ch];
+
+        if(type == CharControl)
+        {
+           error =  makeError(ControlCharacterDetectionMsg, buffer);
+           return false;
+        }
+
+        //-----------------------------------------------------------------------
+
+        if(type == CharSpace || type == CharComma || type == CharObjectEnd || type == CharArrayEnd)
+        {
+           exit = true;
+           break;
+        }
+
+        //-----------------------------------------------------------------------
+
+        if(exponent > 0)
+        {
+           if(ch == '-' || ch == '+')
+           {
+              if(temp.size() != exponent + 1)
+              {
+                 error =  makeError(InvalidNumberMsg, buffer);
+                 return false;
+              }
+           }
+           else if(type != CharNumber)
+           {
+              error =  makeError(InvalidNumberMsg, buffer);
+              return false;
+           }
+           else exponentDigits++;
+
+           temp.push_back(ch);
+           continue;
+        }
+
+        //-----------------------------------------------------------------------
+
+        if(ch == '.')
+        {
+           if(points == 1 || temp.back() == '-')
+           {
+              error =  makeError(ALotPointMsg, buffer);
+              return false;
+           }
+
+           temp.push_back(ch);
+           points++;
+           continue;
+        }
+
+        if(ch == 'e' || ch == 'E')
+        {
+           if(temp.back() == '-' || temp.back() == '.')
+           {
+              error =  makeError(InvalidNumberMsg, buffer);
+              return false;
+           }
+
+           exponent = temp.size();
+           temp.push_back(ch);
+           continue;
+        }
+
+        if(type != CharNumber || ch == '-')
+        {
+           error =  makeError(InvalidNumberMsg, buffer);
+           return false;
+        }
+
+        temp.push_back(ch);
+    }
+
+    if(!exit)
+    {
+       error =  makeError(NumberOutOfArrayMsg, buffer);
+       return false;
+    }
+
+    if(temp.back() == '.')
+    {
+       error =  makeError(ALotPointMsg, buffer);
+       return false;
+    }
+
+    if(exponent > 0 && exponentDigits == 0)
+    {
+       error =  makeError(InvalidNumberMsg, buffer);
+       return false;
+    }
+
+    const char * first = temp.data(), * last = temp.data() + temp.size();
+
+    if(points == 0 && exponent == 0)
+    {
+       long long value;
+       auto [ptr, ec] { std::from_chars(first, last, value) };
+
+       //-0 keeps its sign as a double
+       if(ec == std::errc() && ptr == last && (value != 0 || !neg))
+       {
+          JSON_STAT(stats.integers++; stats.numberCycles += statsClock() - begin);
+          JSON_TIMED(stats.handlerCycles, handler.Value(value));
+          return true;
+       }
+
+       //Integers out of the long long range are read as doubles
+       if(ec != std::errc() && ec != std::errc::result_out_of_range)
+       {
+          error =  makeError(NumberRangeMsg, buffer);
+          return false;
+       }
+    }
+
+    double value;
+    auto [ptr, ec] { std::from_chars(first, last, value) };
+
+    if(ec != std::errc() || ptr != last)
+    {
+       error =  makeError(NumberRangeMsg, buffer);
+       return false;
+    }
+
+    JSON_STAT(stats.doubles++; stats.numberCycles += statsClock() - begin);
+    JSON_TIMED(stats.handlerCycles, handler.Value(value));
+    return true;
+}
+
+//----------------------------------------------------------------
+//JSON5 tokens, the character after a token stays in the buffer and is processed by the tokenizer
+
+inline bool readyWord(unsigned char first, std::string & temp, std::size_t budget, JsonBufferReader & buffer, std::string & error)
+{
+    temp.clear();
+    temp.push_back(first);
+
+    while(buffer.next())
+    {
+        if(!spendByte(budget, buffer, error)) return false;
+        const unsigned char ch = buffer.value();
+        if(!isIdentifierPart(ch)) return true;
+        temp.push_back(ch);
+    }
+
+    error =  makeError(ValueOutOfArrayMsg, buffer);
+    return false;
+}
+
+template<typename Handler>
+inline bool readyIdentifierKey(unsigned char first, std::string & temp, std::size_t maxSize, std::size_t budget, Handler & handler, JsonBufferReader & buffer, std::string & error, [[maybe_unused]] JsonStats & stats)
+{
+    if(!readyWord(first, temp, budget, buffer, error)) return false;
+
+    if(temp.size() > maxSize)
+    {
+       error = makeError(StringLimitMsg, buffer);
+       return false;
+    }
+
+    JSON_STAT(stats.keys++; stats.stringBytes += temp.size());
+    JSON_TIMED(stats.handlerCycles, handler.ObjectKey(temp));
+    return true;
+}
+
+//true, false, null, Infinity, NaN
+template<typename Handler>
+inline bool readyLiteral5(unsigned char first, std::string & temp, std::size_t budget, Handler & handler, JsonBufferReader & buffer, std::string & error, [[maybe_unused]] JsonStats & stats)
+{
+    if(!readyWord(first, temp, budget, buffer, error)) return false;
+
+    if(temp == "true" || temp == "false")
+    {
+       JSON_STAT(stats.bools++);
+       JSON_TIMED(stats.handlerCycles, handler.Value(temp.size() == 4));
+    }
+    else if(temp == "null")
+    {
+       JSON_STAT(stats.nulls++);
+       JSON_TIMED(stats.handlerCycles, handler.Null());
+    }
+    else if(temp == "Infinity" || temp == "NaN")
+    {
+       JSON_STAT(stats.doubles++);
+       JSON_TIMED(stats.handlerCycles, handler.Value((temp.size() == 3) ? std::numeric_limits<double>::quiet_NaN() : std::numeric_limits<double>::infinity()));
+    }
+    else
+    {
+       error =  makeError(InvalidValueMsg, buffer);
+       return false;
+    }
+
+    return true;
+}
+
+//Leading '+', hexadecimal integers, leading or trailing point, signed Infinity and NaN
+template<typename Handler>
+inline bool readyNumber5(const unsigned char first, std::string & temp, std::size_t budget, Handler & handler, JsonBufferReader & buffer, std::string & error, [[maybe_unused]] JsonStats & stats)
+{
+    JSON_STAT(const std::uint64_t begin = statsClock());
+    bool exit = false;
+
+    temp.clear();
+    temp.push_back(first);
+
+    while(buffer.next())
+    {
+        if(!spendByte(budget, buffer, error)) return false;
+        const unsigned char ch = buffer.value();
+
+        if(!isIdentifierPart(ch) && ch != '.' && ch != '+' && ch != '-')
+        {
+           exit = true;
+           break;
+        }
+
+        temp.push_back(ch);
+    }
+
+    if(!exit)
+    {
+       error =  makeError(NumberOutOfArrayMsg, buffer);
+       return false;
+    }
+
+    std::string_view text(temp);
+    const bool neg = (text.front() == '-');
+    if(text.front() == '-' || text.front() == '+') text.remove_prefix(1);
+
+    const char * const last = text.data() + text.size();
+    double real;
+
+    if(text == "Infinity" || text == "NaN")
+    {
+       real = (text.size() == 3) ? std::numeric_limits<double>::quiet_NaN() : std::numeric_limits<double>::infinity();
+    }
+    else if(text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    {
+       unsigned long long value;
+       auto [ptr, ec] { std::from_chars(text.data() + 2, last, value, 16) };
+
+       if(ec != std::errc() || ptr != last)
+       {
+          error =  makeError((ec == std::errc::result_out_of_range) ? NumberRangeMsg : InvalidNumberMsg, buffer);
+          return false;
+       }
+
+       constexpr unsigned long long limit = static_cast<unsigned long long>(std::numeric_limits<long long>::max());
+
+       if((!neg && value <= limit) || (neg && value != 0 && value <= limit + 1))
+       {
+          JSON_STAT(stats.integers++; stats.numberCycles += statsClock() - begin);
+          JSON_TIMED(stats.handlerCycles, handler.Value(static_cast<long long>(neg ? 0 - value : value)));
+          return true;
+       }
+
+       real = static_cast<double>(value);
+    }
+    else
+    {
+       if(text.empty() || (text[0] != '.' && (text[0] < '0' || text[0] > '9')))
+       {
+          error =  makeError(InvalidNumberMsg, buffer);
+          return false;
+       }
+
+       //std::from_chars reads '-' but not '+'
+       const char * const first = (neg) ? text.data() - 1 : text.data();
+
+       if(text.find_first_of(".eE") == std::string_view::npos)
+       {
+          long long value;
+          auto [ptr, ec] { std::from_chars(first, last, value) };
+
+          //-0 keeps its sign as a double, integers out of the long long range are read as doubles
+          if(ec == std::errc() && ptr == last && (value != 0 || !neg))
+          {
+             JSON_STAT(stats.integers++; stats.numberCycles += statsClock() - begin);
+             JSON_TIMED(stats.handlerCycles, handler.Value(value));
+             return true;
+          }
+       }
+
+       auto [ptr, ec] { std::from_chars(first, last, real) };
+
+       if(ec != std::errc() || ptr != last)
+       {
+          error =  makeError((ec == std::errc::result_out_of_range) ? NumberRangeMsg : InvalidNumberMsg, buffer);
+          return false;
+       }
+
+       JSON_STAT(stats.doubles++; stats.numberCycles += statsClock() - begin);
+       JSON_TIMED(stats.handlerCycles, handler.Value(real));
+       return true;
+    }
+
+    JSON_STAT(stats.doubles++; stats.numberCycles += statsClock() - begin);
+    JSON_TIMED(stats.handlerCycles, handler.Value(neg ? -real : real));
+    return true;
+}
+
+//From the '/': a line comment up to the end of the line or of the input (end), a block comment
+inline bool skipComment(JsonBufferReader & buffer, std::size_t budget, bool & end, std::string & error)
+{
+    end = false;
+
+    if(!buffer.next() || (buffer.value() != '/' && buffer.value() != '*'))
+    {
+       error =  makeError(InvalidCommentMsg, buffer);
+       return false;
+    }
+
+    if(!spendByte(budget, buffer, error)) return false;
+
+    if(buffer.value() == '/')
+    {
+       while(buffer.next())
+       {
+           if(!spendByte(budget, buffer, error)) return false;
+           if(buffer.value() == '\n' || buffer.value() == '\r') return true;
+       }
+
+       end = true;
+       return true;
+    }
+
+    bool star = false;
+    while(buffer.next())
+    {
+        if(!spendByte(budget, buffer, error)) return false;
+        const unsigned char ch = buffer.value();
+        if(star && ch == '/') return true;
+        star = (ch == '*');
+    }
+
+    error =  makeError(InvalidCommentMsg, buffer);
+    return false;
+}
+
+//----------------------------------------------------------------
+
+inline bool readyValue(std::string_view value, JsonBufferReader & buffer, std::string & error)
+{
+    std::size_t i = 0;
+    while(i < value.size() && buffer.next())
+    {
+          unsigned char ch = buffer.value();
+
+          if(isControlCode(ch))
+          {
+           error =  makeError(ControlCharacterDetectionMsg, buffer);
+           return false;
+          }
+
+          if(ch != value[i])
+          {
+             error =  makeError(InvalidValueMsg, buffer);
+             return false;
+          }
+
+          i++;
+    }
+
+    if(i != value.size())
+    {
+       error =  makeError(ValueOutOfArrayMsg, buffer);
+       return false;
+    }
+
+    return true;
+}
+
+//MessagePack, CBOR
+
+inline const char * const InvalidBinaryItemMsg = "Invalid or unsupported binary item, offset: ",
+                  * const InvalidBinaryKeyMsg = "Object key is not a string, offset: ",
+                  * const InvalidBinaryEntryMsg = "Root value is not an object or an array, offset: ",
+                  * const InvalidBinaryBreakMsg = "Unexpected break of indefinite length item, offset: ";
+
+struct BinaryItem
+{
+    enum Kind : unsigned char
+    {
+         Object = 0,
+         Array,
+         String,
+         Double,
+         LongLong,
+         Bool,
+         Null,
+         Break,
+         Tag
+    };
+
+    Kind kind = Null;
+    bool indefinite = false;
+    std::uint64_t size = 0; //pairs or values of container
+    double real = 0;
+    long long integer = 0;
+    bool boolean = false;
+};
+
+inline bool readBigEndian(JsonBufferReader & buffer, std::size_t size, std::uint64_t & value, std::size_t & budget, std::string & error)
+{
+    value = 0;
+    if(!spendBytes(budget, size, buffer, error)) return false;
+
+    for(std::size_t i = 0; i < size; i++)
+    {
+        if(!buffer.next())
+        {
+           error = UnexpectedEndMsg;
+           return false;
+        }
+
+        value = (value << 8) | buffer.value();
+    }
+
+    return true;
+}
+
+//budget - bytes of the document left, a string beyond it is not read
+inline bool readBinaryString(JsonBufferReader & buffer, std::uint64_t size, std::size_t maxSize, std::size_t & budget, std::string & temp, std::string & error)
+{
+    if(size > maxSize - temp.size())
+    {
+       error = makeError(StringLimitMsg, buffer);
+       return false;
+    }
+
+    if(!spendBytes(budget, size, buffer, error)) return false;
+
+    for(std::uint64_t i = 0; i < size; i++)
+    {
+        if(!buffer.next())
+        {
+           error = UnexpectedEndMsg;
+           return false;
+        }
+
+        temp.push_back(static_cast<char>(buffer.value()));
+    }
+
+    return true;
+}
+
+inline bool setBinaryInteger(std::uint64_t value, BinaryItem & item, JsonBufferReader & buffer, std::string & error)
+{
+    if(value > static_cast<std::uint64_t>(std::numeric_limits<long long>::max()))
+    {
+       error = makeError(NumberRangeMsg, buffer);
+       return false;
+    }
+
+    item.kind = BinaryItem::LongLong;
+    item.integer = static_cast<long long>(value);
+    return true;
+}
+
+inline bool readMessagePackItem(JsonBufferReader & buffer, BinaryItem & item, std::size_t maxSize, std::size_t budget, std::string & temp, std::string & error)
+{
+    const unsigned char ch = buffer.value();
+    std::uint64_t value = 0;
+    item.indefinite = false;
+
+    if(ch <= 0x7f)
+    {
+       item.kind = BinaryItem::LongLong;
+       item.integer = ch;
+       return true;
+    }
+
+    if(ch >= 0xe0)
+    {
+       item.kind = BinaryItem::LongLong;
+       item.integer = static_cast<signed char>(ch);
+       return true;
+    }
+
+    if((ch & 0xf0) == 0x80 || (ch & 0xf0) == 0x90)
+    {
+       item.kind = ((ch & 0xf0) == 0x80) ? BinaryItem::Object : BinaryItem::Array;
+       item.size = ch & 0x0f;
+       return true;
+    }
+
+    if((ch & 0xe0) == 0xa0)
+    {
+       item.kind = BinaryItem::String;
+       return readBinaryString(buffer, ch & 0x1f, maxSize, budget, temp, error);
+    }
+
+    switch(ch)
+    {
+       case 0xc0: item.kind = BinaryItem::Null;
+       return true;
+       case 0xc2:
+       case 0xc3:
+       {
+          item.kind = BinaryItem::Bool;
+          item.boolean = (ch == 0xc3);
+       }
+       return true;
+       case 0xc4: //bin 8, 16, 32 - bytes as string
+       case 0xc5:
+       case 0xc6:
+       case 0xd9: //str 8, 16, 32
+       case 0xda:
+       case 0xdb:
+       {
+          const std::size_t size = std::size_t(1) << ((ch <= 0xc6) ? ch - 0xc4 : ch - 0xd9);
+          if(!readBigEndian(buffer, size, value, budget, error)) return false;
+          item.kind = BinaryItem::String;
+       }
+       return readBinaryString(buffer, value, maxSize, budget, temp, error);
+       case 0xca:
+       {
+          if(!readBigEndian(buffer, 4, value, budget, error)) return false;
+          item.kind = BinaryItem::Double;
+          item.real = std::bit_cast<float>(static_cast<std::uint32_t>(value));
+       }
+       return true;
+       case 0xcb:
+       {
+          if(!readBigEndian(buffer, 8, value, budget, error)) return false;
+          item.kind = BinaryItem::Double;
+          item.real = std::bit_cast<double>(value);
+       }
+       return true;
+       case 0xcc: //uint 8, 16, 32, 64
+       case 0xcd:
+       case 0xce:
+       case 0xcf:
+       {
+          if(!readBigEndian(buffer, std::size_t(1) << (ch - 0xcc), value, budget, error)) return false;
+       }
+       return setBinaryInteger(value, item, buffer, error);
+       case 0xd0: //int 8, 16, 32, 64
+       case 0xd1:
+       case 0xd2:
+       case 0xd3:
+       {
+          if(!readBigEndian(buffer, std::size_t(1) << (ch - 0xd0), value, budget, error)) return false;
+          item.kind = BinaryItem::LongLong;
+
+          switch(ch)
+          {
+             case 0xd0: item.integer = static_cast<std::int8_t>(value);
+             break;
+             case 0xd1: item.integer = static_cast<std::int16_t>(value);
+             break;
+             case 0xd2: item.integer = static_cast<std::int32_t>(value);
+             break;
+             default: item.integer = static_cast<std::int64_t>(value);
+          }
+       }
+       return true;
+       case 0xdc: //array 16, 32
+       case 0xdd:
+       case 0xde: //map 16, 32
+       case 0xdf:
+       {
+          if(!readBigEndian(buffer, (ch == 0xdc || ch == 0xde) ? 2 : 4, value, budget, error)) return false;
+          item.kind = (ch < 0xde) ? BinaryItem::Array : BinaryItem::Object;
+          item.size = value;
+       }
+       return true;
+       default: break;
+    }
+
+    error = makeError(InvalidBinaryItemMsg, buffer);
+    return false;
+}
+
+inline bool readCBORArgument(JsonBufferReader & buffer, unsigned char info, std::uint64_t & value, std::size_t & budget, std::string & error)
+{
+    if(info < 24)
+    {
+       value = info;
+       return true;
+    }
+
+    if(info > 27)
+    {
+       error = makeError(InvalidBinaryItemMsg, buffer);
+       return false;
+    }
+
+    return readBigEndian(buffer, std::size_t(1) << (info - 24), value, budget, error);
+}
+
+inline double halfToDouble(std::uint16_t half)
+{
+    const int exponent = (half >> 10) & 0x1f;
+    const double mantissa = half & 0x3ff;
+    double value;
+
+    if(exponent == 0) value = std::ldexp(mantissa, -24);
+    else if(exponent != 31) value = std::ldexp(mantissa + 1024, exponent - 25);
+    else value = (mantissa == 0) ? std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+
+    return (half & 0x8000) ? -value : value;
+}
+
+inline bool readCBORItem(JsonBufferReader & buffer, BinaryItem & item, std::size_t maxSize, std::size_t budget, std::string & temp, std::string & error)
+{
+    const unsigned char ch = buffer.value();
+    const unsigned char major = ch >> 5, info = ch & 0x1f;
+    std::uint64_t value = 0;
+    item.indefinite = false;
+
+    if(ch == 0xff)
+    {
+       item.kind = BinaryItem::Break;
+       return true;
+    }
+
+    if(info == 31)
+    {
+       if(major == 2 || major == 3) //chunks of definite length strings
+       {
+          item.kind = BinaryItem::String;
+
+          while(true)
+          {
+             if(!buffer.next())
+             {
+                error = UnexpectedEndMsg;
+                return false;
+             }
+
+             if(!spendByte(budget, buffer, error)) return false;
+             const unsigned char chunk = buffer.value();
+             if(chunk == 0xff) return true;
+
+             if((chunk >> 5) != major || (chunk & 0x1f) == 31)
+             {
+                error = makeError(InvalidBinaryItemMsg, buffer);
+                return false;
+             }
+
+             if(!readCBORArgument(buffer, chunk & 0x1f, value, budget, error) || !readBinaryString(buffer, value, maxSize, budget, temp, error)) return false;
+          }
+       }
+
+       if(major == 4 || major == 5)
+       {
+          item.kind = (major == 5) ? BinaryItem::Object : BinaryItem::Array;
+          item.indefinite = true;
+          return true;
+       }
+
+       error = makeError(InvalidBinaryItemMsg, buffer);
+       return false;
+    }
+
+    if(!readCBORArgument(buffer, info, value, budget, error)) return false;
+
+    switch(major)
+    {
+       case 0: return setBinaryInteger(value, item, buffer, error);
+       case 1:
+       {
+          if(!setBinaryInteger(value, item, buffer, error)) return false;
+          item.integer = -1 - item.integer;
+       }
+       return true;
+       case 2:
+       case 3:
+       {
+          item.kind = BinaryItem::String;
+       }
+       return readBinaryString(buffer, value, maxSize, budget, temp, error);
+       case 4:
+       case 5:
+       {
+          item.kind = (major == 5) ? BinaryItem::Object : BinaryItem::Array;
+          item.size = value;
+       }
+       return true;
+       case 6: item.kind = BinaryItem::Tag; //tags are skipped, the tagged item is read as is
+       return true;
+       default: break;
+    }
+
+    switch(info)
+    {
+       case 20:
+       case 21:
+       {
+          item.kind = BinaryItem::Bool;
+          item.boolean = (info == 21);
+       }
+       return true;
+       case 22:
+       case 23: item.kind = BinaryItem::Null; //null, undefined
+       return true;
+       case 25:
+       {
+          item.kind = BinaryItem::Double;
+          item.real = halfToDouble(static_cast<std::uint16_t>(value));
+       }
+       return true;
+       case 26:
+       {
+          item.kind = BinaryItem::Double;
+          item.real = std::bit_cast<float>(static_cast<std::uint32_t>(value));
+       }
+       return true;
+       case 27:
+       {
+          item.kind = BinaryItem::Double;
+          item.real = std::bit_cast<double>(value);
+       }
+       return true;
+       default: break;
+    }
+
+    error = makeError(InvalidBinaryItemMsg, buffer);
+    return false;
+}
+
+} // inline namespace
+} // namespace JsonSAXDetail
+
+//----------------------------------------------------------------
+
+//The tokenizer calls the handler through it: callbacks of a handler befriending JsonSAXParser may be private
+template<typename Handler>
+struct JsonSAXParser::Callbacks
+{
+    Handler & handler;
+
+    void JsonBegin(){ handler.JsonBegin(); }
+    void JsonEnd(){ handler.JsonEnd(); }
+
+    void ObjectBegin(){ handler.ObjectBegin(); }
+    void ObjectKey(const std::string & key){ handler.ObjectKey(key); }
+    void ObjectEnd(){ handler.ObjectEnd(); }
+
+    void ArrayBegin(){ handler.ArrayBegin(); }
+    void ArrayEnd(){ handler.ArrayEnd(); }
+
+    void Value(const std::string & value){ handler.Value(value); }
+    void Value(double value){ handler.Value(value); }
+    void Value(long long value){ handler.Value(value); }
+    void Value(bool value){ handler.Value(value); }
+    void Null(){ handler.Null(); }
+};
+
+template<typename Handler>
+bool JsonSAXParser::parse(Handler & handler, JsonBufferReader & buffer, Operation operation, JsonFormat format)
+{
+    Callbacks<Handler> callbacks{handler};
+    bool ret;
+
+    //a bounded memory resource (JsonValue::MemoryScope) fails the parse instead of escaping it
+    try
+    {
+       switch(format)
+       {
+          case JsonFormat::Text:
+          case JsonFormat::Canonical: JSON_TIMED(_stats.totalCycles, ret = parseText<false>(callbacks, buffer, operation));
+          break;
+          case JsonFormat::JSON5: JSON_TIMED(_stats.totalCycles, ret = parseText<true>(callbacks, buffer, operation));
+          break;
+          default: JSON_TIMED(_stats.totalCycles, ret = parseBinary(callbacks, buffer, operation, format));
+       }
+    }
+    catch(const std::bad_alloc &)
+    {
+       _error = JsonSAXDetail::makeError(JsonSAXDetail::OutOfMemoryMsg, buffer);
+       return false;
+    }
+
+    return ret;
+}
+
+//Json5 - the JSON5 grammar, its own instantiation, strict text reading does not test for it
+template<bool Json5, typename Handler>
+bool JsonSAXParser::parseText(Handler & handler, JsonBufferReader & buffer, Operation operation) //pop top
+{
+    using namespace JsonSAXDetail;
+    constexpr const std::array<CharClass, 256> & classes = (Json5) ? charClasses5 : charClasses;
+    constexpr const TransitionTable & table = (Json5) ? transitions5 : transitions;
+
+    stop = false;
+    while(!depth.empty()) depth.pop();
+
+#if defined(__GNUC__)
+    static void * const jumps[ActionCount] =
+    {
+        &&OnError, &&OnColon, &&OnNextPair, &&OnObjectEnd, &&OnNextValue, &&OnArrayEnd, &&OnComment,
+        &&OnRootObject, &&OnRootArray, &&OnKey, &&OnIdentifierKey, &&OnObject, &&OnArray, &&OnString, &&OnNumber, &&OnLiteral
+    };
+#endif
+
+    bool pending = false; //the character that ended a number is not processed yet
+    std::size_t tokens = 0, start = NoLimit; //offset of the document's first byte, JsonFileBufferReader counts from 1
+    JSON_STAT(std::size_t document = 0);
+
+    while(pending || buffer.next())
+    {
+        pending = false;
+
+        const unsigned char ch = buffer.value();
+        const CharClass type = classes[ch];
+        std::size_t budget = NoLimit; //bytes the token starting here may read after ch
+
+        if(maxBytes != NoLimit)
+        {
+           if(start == NoLimit) start = buffer.offset();
+           const std::size_t used = buffer.offset() - start;
+
+           if(used >= maxBytes)
+           {
+              _error = makeError(SizeLimitMsg, buffer);
+              return false;
+           }
+
+           budget = maxBytes - 1 - used;
+        }
+
+        if(type == CharSpace) continue;
+
+        if(type == CharControl)
+        {
+           _error =  makeError(ControlCharacterDetectionMsg, buffer);
+           return false;
+        }
+
+        const std::size_t state = (depth.empty()) ? RootState : static_cast<std::size_t>(depth.top());
+        const Action action = table[state][type];
+
+        if(action >= ActionRootObject && ++tokens > maxTokens)
+        {
+           _error = makeError(TokenLimitMsg, buffer);
+           return false;
+        }
+
+#if defined(__GNUC__)
+        goto *jumps[action];
+#else
+        switch(action)
+        {
+           case ActionRootObject: goto OnRootObject;
+           case ActionRootArray: goto OnRootArray;
+           case ActionKey: goto OnKey;
+           case ActionIdentifierKey: goto OnIdentifierKey;
+           case ActionColon: goto OnColon;
+           case ActionNextPair: goto OnNextPair;
+           case ActionObjectEnd: goto OnObjectEnd;
+           case ActionNextValue: goto OnNextValue;
+           case ActionArrayEnd: goto OnArrayEnd;
+           case ActionComment: goto OnComment;
+           case ActionObject: goto OnObject;
+           case ActionArray: goto OnArray;
+           case ActionString: goto OnString;
+           case ActionNumber: goto OnNumber;
+           case ActionLiteral: goto OnLiteral;
+           default: goto OnError;
+        }
+#endif
+
+    OnError:
+        _error = makeStateError(state, ch, buffer);
+        return false;
+
+    OnRootObject:
+        JSON_STAT(document = buffer.offset(); _stats.objects++; _stats.maxDepth = std::max<std::uint64_t>(_stats.maxDepth, 1));
+        JSON_TIMED(_stats.handlerCycles, handler.JsonBegin());
+        depth.push(JsonReaderType::Object);
+        JSON_TIMED(_stats.handlerCycles, handler.ObjectBegin());
+        continue;
+
+    OnRootArray:
+        JSON_STAT(document = buffer.offset(); _stats.arrays++; _stats.maxDepth = std::max<std::uint64_t>(_stats.maxDepth, 1));
+        JSON_TIMED(_stats.handlerCycles, handler.JsonBegin());
+        depth.push(JsonReaderType::Array);
+        JSON_TIMED(_stats.handlerCycles, handler.ArrayBegin());
+        continue;
+
+    OnKey:
+        if(!readyObjectKey<Json5>(temp, ch, maxString, budget, handler, buffer, _error, _stats)) return false;
+        depth.top() = JsonReaderType::ObjectKey;
+        continue;
+
+    OnIdentifierKey:
+        if constexpr(Json5)
+        {
+           if(!readyIdentifierKey(ch, temp, maxString, budget, handler, buffer, _error, _stats)) return false;
+           depth.top() = JsonReaderType::ObjectKey;
+           pending = true;
+           continue;
+        }
+        goto OnError;
+
+    OnComment:
+        if constexpr(Json5)
+        {
+           bool end;
+           if(!skipComment(buffer, budget, end, _error)) return false;
+           if(end) break;
+           continue;
+        }
+        goto OnError;
+
+    OnColon:
+        depth.top() = JsonReaderType::ObjectValue;
+        continue;
+
+    OnNextPair:
+        depth.top() = JsonReaderType::ObjectNextKey;
+        continue;
+
+    OnNextValue:
+        depth.top() = JsonReaderType::ArrayNextValue;
+        continue;
+
+    OnObjectEnd:
+        depth.pop();
+        JSON_TIMED(_stats.handlerCycles, handler.ObjectEnd());
+        goto OnContainerEnd;
+
+    OnArrayEnd:
+        depth.pop();
+        JSON_TIMED(_stats.handlerCycles, handler.ArrayEnd());
+
+    OnContainerEnd:
+        if(depth.empty())
+        {
+           JSON_STAT(_stats.bytes += buffer.offset() - document + 1);
+           JSON_TIMED(_stats.handlerCycles, handler.JsonEnd());
+           if(operation == Single) break;
+           if(stop) break;
+
+           tokens = 0;
+           start = buffer.offset() + 1;
+        }
+        continue;
+
+    OnObject:
+        if(depth.size() == maxDepth) goto OnDepthLimit;
+        depth.top() = (state == static_cast<std::size_t>(JsonReaderType::ObjectValue)) ? JsonReaderType::ObjectNextPair : JsonReaderType::ArrayNext;
+        depth.push(JsonReaderType::Object);
+        JSON_STAT(_stats.objects++; _stats.maxDepth = std::max<std::uint64_t>(_stats.maxDepth, depth.size()));
+        JSON_TIMED(_stats.handlerCycles, handler.ObjectBegin());
+        continue;
+
+    OnArray:
+        if(depth.size() == maxDepth) goto OnDepthLimit;
+        depth.top() = (state == static_cast<std::size_t>(JsonReaderType::ObjectValue)) ? JsonReaderType::ObjectNextPair : JsonReaderType::ArrayNext;
+        depth.push(JsonReaderType::Array);
+        JSON_STAT(_stats.arrays++; _stats.maxDepth = std::max<std::uint64_t>(_stats.maxDepth, depth.size()));
+        JSON_TIMED(_stats.handlerCycles, handler.ArrayBegin());
+        continue;
+
+    OnString:
+        depth.top() = (state == static_cast<std::size_t>(JsonReaderType::ObjectValue)) ? JsonReaderType::ObjectNextPair : JsonReaderType::ArrayNext;
+        if(!readyStringValue<Json5>(temp, ch, maxString, budget, handler, buffer, _error, _stats)) return false;
+        continue;
+
+    OnNumber:
+        depth.top() = (state == static_cast<std::size_t>(JsonReaderType::ObjectValue)) ? JsonReaderType::ObjectNextPair : JsonReaderType::ArrayNext;
+        if constexpr(Json5)
+        {
+           if(!readyNumber5(ch, temp, budget, handler, buffer, _error, _stats)) return false;
+        }
+        else if(!readyNumber(ch, temp, budget, handler, buffer, _error, _stats)) return false;
+        pending = true;
+        continue;
+
+    OnLiteral:
+        depth.top() = (state == static_cast<std::size_t>(JsonReaderType::ObjectValue)) ? JsonReaderType::ObjectNextPair : JsonReaderType::ArrayNext;
+
+        if constexpr(Json5)
+        {
+           if(!readyLiteral5(ch, temp, budget, handler, buffer, _error, _stats)) return false;
+           pending = true;
+           continue;
+        }
+
+        if(ch == 't')
+        {
+           if(!readyValue("rue", buffer, _error)) return false;
+           JSON_STAT(_stats.bools++);
+           JSON_TIMED(_stats.handlerCycles, handler.Value(true));
+        }
+        else if(ch == 'f')
+        {
+           if(!readyValue("alse", buffer, _error)) return false;
+           JSON_STAT(_stats.bools++);
+           JSON_TIMED(_stats.handlerCycles, handler.Value(false));
+        }
+        else
+        {
+           if(!readyValue("ull", buffer, _error)) return false;
+           JSON_STAT(_stats.nulls++);
+           JSON_TIMED(_stats.handlerCycles, handler.Null());
+        }
+        continue;
+
+    OnDepthLimit:
+        _error = makeError(DepthLimitMsg, buffer);
+        return false;
+    }
+
+    if(!depth.empty())
+    {
+       _error = UnexpectedEndMsg;
+       return false;
+    }
+
+    return true;
+}
+
+template<typename Handler>
+bool JsonSAXParser::parseBinary(Handler & handler, JsonBufferReader & buffer, Operation operation, JsonFormat format)
+{
+    using namespace JsonSAXDetail;
+    stop = false;
+    while(!frames.empty()) frames.pop();
+    BinaryItem item;
+    std::size_t tokens = 0, start = NoLimit; //as in parseText
+    JSON_STAT(std::size_t document = 0);
+
+    while(buffer.next())
+    {
+        std::size_t budget = NoLimit; //bytes the item may read after its first one
+
+        if(maxBytes != NoLimit)
+        {
+           if(start == NoLimit) start = buffer.offset();
+           const std::size_t used = buffer.offset() - start;
+
+           if(used >= maxBytes)
+           {
+              _error = makeError(SizeLimitMsg, buffer);
+              return false;
+           }
+
+           budget = maxBytes - 1 - used;
+        }
+
+        temp.clear();
+        JSON_STAT(const std::size_t itemStart = buffer.offset(); const std::size_t capacity = temp.capacity(); const std::uint64_t readBegin = statsClock());
+        bool read = (format == JsonFormat::MessagePack) ? readMessagePackItem(buffer, item, maxString, budget, temp, _error) : readCBORItem(buffer, item, maxString, budget, temp, _error);
+        if(!read) return false;
+        JSON_STAT(const std::uint64_t readCycles = statsClock() - readBegin; _stats.allocations += (temp.capacity() != capacity));
+
+        if(++tokens > maxTokens)
+        {
+           _error = makeError(TokenLimitMsg, buffer);
+           return false;
+        }
+
+        if(item.kind == BinaryItem::Tag) continue;
+
+#if defined(JSON_STATS)
+        switch(item.kind)
+        {
+           case BinaryItem::Object:
+           case BinaryItem::Array:
+           {
+              (item.kind == BinaryItem::Object ? _stats.objects : _stats.arrays)++;
+              _stats.maxDepth = std::max<std::uint64_t>(_stats.maxDepth, frames.size() + 1);
+           }
+           break;
+           case BinaryItem::String:
+           {
+              const bool key = !frames.empty() && frames.top().object && !frames.top().key;
+              (key ? _stats.keys : _stats.strings)++;
+              _stats.stringBytes += temp.size();
+              _stats.stringCycles += readCycles;
+           }
+           break;
+           case BinaryItem::Double: _stats.doubles++; _stats.numberCycles += readCycles;
+           break;
+           case BinaryItem::LongLong: _stats.integers++; _stats.numberCycles += readCycles;
+           break;
+           case BinaryItem::Bool: _stats.bools++;
+           break;
+           case BinaryItem::Null: _stats.nulls++;
+           break;
+           default:
+           break;
+        }
+#endif
+
+        bool complete = true;
+
+        if(frames.empty())
+        {
+           if(item.kind != BinaryItem::Object && item.kind != BinaryItem::Array)
+           {
+              _error = makeError(InvalidBinaryEntryMsg, buffer);
+              return false;
+           }
+
+           JSON_STAT(document = itemStart);
+           JSON_TIMED(_stats.handlerCycles, handler.JsonBegin());
+        }
+
+        if(item.kind == BinaryItem::Break)
+        {
+           if(!frames.top().indefinite || frames.top().key)
+           {
+              _error = makeError(InvalidBinaryBreakMsg, buffer);
+              return false;
+           }
+
+           const bool object = frames.top().object;
+           frames.pop();
+           if(object) JSON_TIMED(_stats.handlerCycles, handler.ObjectEnd());
+           else JSON_TIMED(_stats.handlerCycles, handler.ArrayEnd());
+        }
+        else if(!frames.empty() && frames.top().object && !frames.top().key)
+        {
+           if(item.kind != BinaryItem::String)
+           {
+              _error = makeError(InvalidBinaryKeyMsg, buffer);
+              return false;
+           }
+
+           JSON_TIMED(_stats.handlerCycles, handler.ObjectKey(temp));
+           frames.top().key = true;
+           continue;
+        }
+        else
+        {
+           switch(item.kind)
+           {
+              case BinaryItem::Object:
+              case BinaryItem::Array:
+              {
+                 const bool object = (item.kind == BinaryItem::Object);
+                 if(object) JSON_TIMED(_stats.handlerCycles, handler.ObjectBegin());
+                 else JSON_TIMED(_stats.handlerCycles, handler.ArrayBegin());
+
+                 if(item.indefinite || item.size > 0)
+                 {
+                    if(frames.size() == maxDepth)
+                    {
+                       _error = makeError(DepthLimitMsg, buffer);
+                       return false;
+                    }
+
+                    frames.push({static_cast<std::size_t>(item.size), object, false, item.indefinite});
+                    complete = false;
+                 }
+                 else if(object) JSON_TIMED(_stats.handlerCycles, handler.ObjectEnd());
+                 else JSON_TIMED(_stats.handlerCycles, handler.ArrayEnd());
+              }
+              break;
+              case BinaryItem::String: JSON_TIMED(_stats.handlerCycles, handler.Value(temp));
+              break;
+              case BinaryItem::Double: JSON_TIMED(_stats.handlerCycles, handler.Value(item.real));
+              break;
+              case BinaryItem::LongLong: JSON_TIMED(_stats.handlerCycles, handler.Value(item.integer));
+              break;
+              case BinaryItem::Bool: JSON_TIMED(_stats.handlerCycles, handler.Value(item.boolean));
+              break;
+              default: JSON_TIMED(_stats.handlerCycles, handler.Null());
+           }
+        }
+
+        while(complete && !frames.empty())
+        {
+           BinaryFrame & top = frames.top();
+           top.key = false;
+           if(top.indefinite || --top.remaining > 0) break;
+
+           const bool object = top.object;
+           frames.pop();
+           if(object) JSON_TIMED(_stats.handlerCycles, handler.ObjectEnd());
+           else JSON_TIMED(_stats.handlerCycles, handler.ArrayEnd());
+        }
+
+        if(frames.empty())
+        {
+           JSON_STAT(_stats.bytes += buffer.offset() - document + 1);
+           JSON_TIMED(_stats.handlerCycles, handler.JsonEnd());
+           if(operation == Single) break;
+           if(stop) break;
+
+           tokens = 0;
+           start = buffer.offset() + 1;
+        }
+    }
+
+    if(!frames.empty())
+    {
+       _error = UnexpectedEndMsg;
+       return false;
+    }
+
+    return true;
+}
+
+//the hooks do not leak into the includers
+#undef JSON_STAT
+#undef JSON_TIMED
+
+#endif // JSON_SAX_PARSER_H
@@ -0,0 +1,41 @@
+//Hooks of the JsonStats counters, internal to the library: JsonSAXParser.h includes this header and
+//#undefs the macros at its end, Json.cpp includes it again for the hooks of the writers and the tree.
+//No include guard, the macros are defined again on every inclusion.
+
+#if defined(JSON_STATS)
+
+#ifndef JSON_STATS_CLOCK
+#define JSON_STATS_CLOCK
+
+#include <cstdint>
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+
+namespace JsonSAXDetail
+{
+#if defined(__x86_64__) || defined(_M_X64)
+inline std::uint64_t statsClock(){ return __rdtsc(); }
+#else
+inline std::uint64_t statsClock(){ return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()); }
+#endif
+}
+
+#endif // JSON_STATS_CLOCK
+
+#define JSON_STAT(...) __VA_ARGS__
+//Adds the time of a statement to a cycle counter of JsonStats
+#define JSON_TIMED(counter, ...) do { const std::uint64_t statBegin = JsonSAXDetail::statsClock(); __VA_ARGS__; counter += JsonSAXDetail::statsClock() - statBegin; } while(false)
+
+#else
+
+#define JSON_STAT(...)
+#define JSON_TIMED(counter, ...) __VA_ARGS__
+
+#endif
@@ -0,0 +1,60 @@
+#include "BenchSupport.h"
+#include <iostream>
+
+//Allocations made while building a tree, parsing and through the insertion API:
+//g++ -std=c++20 -O2 Json.cpp bench/BenchSupport.cpp bench/AllocBenchmark.cpp -o alloc_benchmark
+
+static std::string makeDocument(std::size_t records)
+{
+    std::string json = "[";
+
+    for(std::size_t i = 0; i < records; i++)
+    {
+        if(i > 0) json += ",\n";
+        json += "{\"identifier_of_record\": " + std::to_string(i * 7919) +
+                ", \"display_name_of_user\": \"user_" + std::to_string(i) + " with a name longer than sso\"" +
+                ", \"score\": " + std::to_string(i % 100) + ".25" +
+                ", \"tags\": [\"a\", \"bb\", \"a tag longer than the sso buffer\"], \"pos\": {\"x\": -12, \"y\": 3.5}}";
+    }
+
+    return json + "]";
+}
+
+template<typename Function>
+static void run(const char * name, std::size_t records, Function function)
+{
+    function(); //warm up
+
+    const std::size_t begin = allocations;
+    function();
+    const std::size_t count = allocations - begin;
+    std::cout << name << ": " << count << " allocations, " << static_cast<double>(count) / records << " per record" << std::endl;
+}
+
+int main()
+{
+    const std::size_t records = 10000;
+    const std::string json = makeDocument(records);
+
+    JsonReader reader;
+    run("JsonReader::parse", records, [&]()
+    {
+        if(reader.parse(json).isEmpty()) std::cerr << reader.error() << std::endl;
+    });
+
+    run("Object::insert / Array::append", records, [&]()
+    {
+        JsonValue::Array array;
+
+        for(std::size_t i = 0; i < records; i++)
+        {
+            JsonValue::Object object;
+            std::string name = "user_" + std::to_string(i) + " with a name longer than sso";
+            object.insert("identifier_of_record", JsonValue(static_cast<long long>(i)));
+            object.insert("display_name_of_user", JsonValue(std::move(name)));
+            array.append(JsonValue(object));
+        }
+    });
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include "BenchSupport.h"
+#include <cstdlib>
+#include <new>
+
+std::size_t allocations = 0;
+
+void * operator new(std::size_t size)
+{
+    allocations++;
+    if(void * ptr = std::malloc((size > 0) ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::size_t) noexcept { std::free(ptr); }
+
+//std::pmr::new_delete_resource allocates with the alignment overloads
+void * operator new(std::size_t size, std::align_val_t align)
+{
+    allocations++;
+    const std::size_t alignment = static_cast<std::size_t>(align);
+    if(void * ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
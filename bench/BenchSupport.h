@@ -0,0 +1,36 @@
+#ifndef JSON_BENCH_SUPPORT_H
+#define JSON_BENCH_SUPPORT_H
+
+#include "../Json.h"
+#include <cstddef>
+
+//Shared parts of the benchmarks. BenchSupport.cpp replaces the global operator new to count its
+//calls, in its own translation unit: a replaced operator delete inlined next to the operator new
+//of a caller is reported by g++ as a mismatched free.
+
+extern std::size_t allocations; //operator new calls, BenchSupport.cpp linked
+
+//Reader events counted and dropped
+class NullHandler final : public JsonSAXReader
+{
+public:
+    std::size_t events = 0;
+
+    void JsonBegin() override {}
+    void JsonEnd() override {}
+
+    void ObjectBegin() override { events++; }
+    void ObjectKey(const std::string &) override { events++; }
+    void ObjectEnd() override { events++; }
+
+    void ArrayBegin() override { events++; }
+    void ArrayEnd() override { events++; }
+
+    void Value(const std::string &) override { events++; }
+    void Value(double) override { events++; }
+    void Value(long long) override { events++; }
+    void Value(bool) override { events++; }
+    void Null() override { events++; }
+};
+
+#endif // JSON_BENCH_SUPPORT_H
@@ -0,0 +1,473 @@
+#include "BenchSupport.h"
+#include "../JsonSAXParser.h"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+//Parse and serialize throughput on a set of corpora, built by the json_benchmark target.
+//twitter.json, citm_catalog.json and canada.json are read from the directory in JSON_BENCH_DATA
+//when it is set, otherwise documents of the same shape are generated.
+//Counters: bytes_per_second - input (parse) or output (write) size, allocs/doc - operator new calls per document.
+
+class Random final
+{
+    std::uint64_t state;
+
+public:
+    explicit Random(std::uint64_t seed) : state(seed){}
+
+    std::uint64_t next()
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return state >> 33;
+    }
+
+    std::size_t below(std::size_t limit){ return static_cast<std::size_t>(next() % limit); }
+    double real(double min, double max){ return min + (max - min) * static_cast<double>(next() % 1000000007ULL) / 1000000007.0; }
+};
+
+//Doubles with 14 significant digits
+static std::string number(double value)
+{
+    std::ostringstream stream;
+    stream.precision(14);
+    stream << value;
+    return stream.str();
+}
+
+//Status objects: long texts with escapes and UTF-8, nested user objects, 64-bit ids
+static std::string makeTwitter(std::size_t statuses)
+{
+    Random random(1);
+    static const char * const words[] = {"json", "\\u3042\\u3044", "\xe3\x81\x86\xe3\x81\x88", "parser", "https:\\/\\/t.co\\/x", "\\\"quoted\\\"", "#tag", "@user", "\\n"};
+    std::string json = "{\"statuses\":[";
+
+    for(std::size_t i = 0; i < statuses; i++)
+    {
+        std::string text;
+        for(std::size_t w = 0; w < 12 + random.below(12); w++) text += std::string((w > 0) ? " " : "") + words[random.below(std::size(words))];
+
+        if(i > 0) json += ",";
+        json += "{\"created_at\":\"Sun Aug 31 00:29:15 +0000 2014\",\"id\":" + std::to_string(505874924095815681ULL + i) +
+                ",\"id_str\":\"" + std::to_string(505874924095815681ULL + i) + "\",\"text\":\"" + text + "\"" +
+                ",\"truncated\":false,\"in_reply_to_status_id\":null,\"favorited\":" + ((i % 3 == 0) ? "true" : "false") +
+                ",\"user\":{\"id\":" + std::to_string(1186275104 + random.below(100000)) + ",\"name\":\"user " + std::to_string(i) + "\"" +
+                ",\"screen_name\":\"screen_" + std::to_string(i) + "\",\"location\":\"\",\"description\":\"" + text + "\"" +
+                ",\"followers_count\":" + std::to_string(random.below(10000)) + ",\"friends_count\":" + std::to_string(random.below(1000)) +
+                ",\"profile_background_color\":\"C0DEED\",\"default_profile\":true,\"following\":null}" +
+                ",\"entities\":{\"hashtags\":[],\"urls\":[{\"url\":\"https:\\/\\/t.co\\/" + std::to_string(i) + "\",\"indices\":[" +
+                std::to_string(random.below(70)) + "," + std::to_string(70 + random.below(70)) + "]}],\"user_mentions\":[]}" +
+                ",\"retweet_count\":" + std::to_string(random.below(500)) + ",\"lang\":\"ja\"}";
+    }
+
+    return json + "]}";
+}
+
+//Events keyed by id, performances with arrays of small integers and many nulls
+static std::string makeCitm(std::size_t events)
+{
+    Random random(2);
+    std::string json = "{\"events\":{";
+
+    for(std::size_t i = 0; i < events; i++)
+    {
+        const std::string id = std::to_string(138586341 + i);
+        if(i > 0) json += ",";
+        json += "\"" + id + "\":{\"description\":null,\"id\":" + id + ",\"logo\":null,\"name\":\"Event " + std::to_string(i) +
+                "\",\"subTopicIds\":[337184269,337184283],\"subjectCode\":null,\"subtitle\":null,\"topicIds\":[324846099,107888604]}";
+    }
+
+    json += "},\"performances\":[";
+
+    for(std::size_t i = 0; i < events * 2; i++)
+    {
+        if(i > 0) json += ",";
+        json += "{\"eventId\":" + std::to_string(138586341 + i / 2) + ",\"id\":" + std::to_string(339887544 + i) +
+                ",\"logo\":null,\"name\":null,\"prices\":[";
+
+        for(std::size_t p = 0; p < 4; p++) json += std::string((p > 0) ? "," : "") + "{\"amount\":" + std::to_string(90250 - 10000 * p) + ",\"audienceSubCategoryId\":337100890,\"seatCategoryId\":" + std::to_string(338937295 + p) + "}";
+
+        json += "],\"seatCategories\":[{\"areas\":[{\"areaId\":205705999,\"blockIds\":[]},{\"areaId\":205705998,\"blockIds\":[]}],\"seatCategoryId\":338937295}]" +
+                std::string(",\"seatMapImage\":null,\"start\":") + std::to_string(1372701600000ULL + random.below(1000) * 86400000ULL) + ",\"venueCode\":\"PLEYEL_PLEYEL\"}";
+    }
+
+    return json + "]}";
+}
+
+//GeoJSON polygons: long arrays of coordinate pairs with full precision doubles
+static std::string makeCanada(std::size_t points)
+{
+    Random random(3);
+    std::string json = "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[";
+
+    for(std::size_t ring = 0; ring * 1000 < points; ring++)
+    {
+        if(ring > 0) json += ",";
+        json += "[";
+
+        for(std::size_t i = 0; i < 1000 && ring * 1000 + i < points; i++)
+        {
+            if(i > 0) json += ",";
+            json += "[";
+            json += number(random.real(-141.0, -52.0));
+            json += ",";
+            json += number(random.real(41.0, 83.0));
+            json += "]";
+        }
+
+        json += "]";
+    }
+
+    return json + "]}}]}";
+}
+
+//Newline-delimited log records, parsed with JsonSAXReader::Multiple
+static std::string makeLogs(std::size_t records)
+{
+    Random random(4);
+    static const char * const levels[] = {"debug", "info", "warning", "error"};
+    std::string json;
+
+    for(std::size_t i = 0; i < records; i++)
+    {
+        json += "{\"ts\":\"2024-05-01T12:" + std::to_string(10 + i % 50) + ":00.123Z\",\"level\":\"" + levels[random.below(4)] +
+                "\",\"service\":\"api\",\"latency_ms\":" + number(random.real(0.1, 250.0)) + ",\"status\":" + std::to_string(200 + random.below(4) * 100) +
+                ",\"path\":\"\\/v1\\/items\\/" + std::to_string(random.below(100000)) + "\",\"retry\":" + ((i % 7 == 0) ? "true" : "false") + "}\n";
+    }
+
+    return json;
+}
+
+//Arrays of objects nested to the given depth
+static std::string makeDeep(std::size_t documents, std::size_t depth)
+{
+    std::string json = "[";
+
+    for(std::size_t d = 0; d < documents; d++)
+    {
+        if(d > 0) json += ",";
+        for(std::size_t i = 0; i < depth; i++) json += "{\"level\":" + std::to_string(i) + ",\"child\":[";
+        json += "null";
+        for(std::size_t i = 0; i < depth; i++) json += "]}";
+    }
+
+    return json + "]";
+}
+
+static std::string makeNumbers(std::size_t count)
+{
+    Random random(5);
+    std::string json = "[";
+
+    for(std::size_t i = 0; i < count; i++)
+    {
+        if(i > 0) json += ",";
+
+        switch(i % 4)
+        {
+            case 0: json += std::to_string(static_cast<long long>(random.next()) - (1LL << 30)); break;
+            case 1: json += number(random.real(-1e6, 1e6)); break;
+            case 2: json += number(random.real(0.1, 1.0)); break;
+            default: json += std::to_string(random.below(100)); break;
+        }
+    }
+
+    return json + "]";
+}
+
+static std::string makeStrings(std::size_t count)
+{
+    Random random(6);
+    static const char * const pieces[] = {"plain ascii text ", "\\\"escaped\\\" ", "tab\\t", "\\u00e9\\u4e2d ", "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 ", "\\ud83d\\ude00 "};
+    std::string json = "[";
+
+    for(std::size_t i = 0; i < count; i++)
+    {
+        if(i > 0) json += ",";
+        json += "\"";
+        for(std::size_t p = 0; p < 4 + random.below(28); p++) json += pieces[random.below(std::size(pieces))];
+        json += "\"";
+    }
+
+    return json + "]";
+}
+
+//----------------------------------------------------------------
+
+struct Corpus
+{
+    std::string name;
+    std::string json;
+    bool multiple = false;
+    std::string file; //copy on disk for the file readers
+};
+
+static std::string readData(const char * name)
+{
+    const char * dir = std::getenv("JSON_BENCH_DATA");
+    if(dir == nullptr) return std::string();
+
+    std::ifstream stream(std::filesystem::path(dir) / name, std::ios::binary);
+    if(!stream.is_open()) return std::string();
+
+    std::ostringstream data;
+    data << stream.rdbuf();
+    return data.str();
+}
+
+static std::vector<Corpus> & corpora()
+{
+    static std::vector<Corpus> ret;
+    if(!ret.empty()) return ret;
+
+    auto add = [](std::string name, std::string json, bool multiple = false)
+    {
+        Corpus corpus;
+        corpus.file = (std::filesystem::temp_directory_path() / ("jsonparser_bench_" + name + ".json")).string();
+        corpus.name = std::move(name);
+        corpus.json = std::move(json);
+        corpus.multiple = multiple;
+
+        std::ofstream(corpus.file, std::ios::binary) << corpus.json;
+        ret.push_back(std::move(corpus));
+    };
+
+    std::string twitter = readData("twitter.json");
+    std::string citm = readData("citm_catalog.json");
+    std::string canada = readData("canada.json");
+
+    add("twitter", twitter.empty() ? makeTwitter(1000) : std::move(twitter));
+    add("citm_catalog", citm.empty() ? makeCitm(2000) : std::move(citm));
+    add("canada", canada.empty() ? makeCanada(56000) : std::move(canada));
+    add("ndjson_logs", makeLogs(10000), true);
+    add("deep_nesting", makeDeep(200, 500));
+    add("numbers", makeNumbers(100000));
+    add("strings", makeStrings(20000));
+
+    return ret;
+}
+
+//----------------------------------------------------------------
+
+//The events of NullHandler with static dispatch: JsonSAXParser::parse inlines the callbacks
+struct NullCounter
+{
+    std::size_t events = 0;
+
+    void JsonBegin(){}
+    void JsonEnd(){}
+
+    void ObjectBegin(){ events++; }
+    void ObjectKey(const std::string &){ events++; }
+    void ObjectEnd(){ events++; }
+
+    void ArrayBegin(){ events++; }
+    void ArrayEnd(){ events++; }
+
+    void Value(const std::string &){ events++; }
+    void Value(double){ events++; }
+    void Value(long long){ events++; }
+    void Value(bool){ events++; }
+    void Null(){ events++; }
+};
+
+static JsonSAXReader::Operation operation(const Corpus & corpus){ return corpus.multiple ? JsonSAXReader::Multiple : JsonSAXReader::Single; }
+
+//a document of a corpus is the whole input, NDJSON input counts as one
+template<typename Function>
+static void measure(benchmark::State & state, std::size_t bytes, Function function)
+{
+    const std::size_t begin = allocations;
+
+    for(auto _ : state)
+    {
+        if(!function())
+        {
+            state.SkipWithError("failed");
+            return;
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(bytes * state.iterations()));
+    state.counters["allocs/doc"] = benchmark::Counter(static_cast<double>(allocations - begin), benchmark::Counter::kAvgIterations);
+}
+
+static void saxReader(benchmark::State & state, const Corpus & corpus)
+{
+    NullHandler handler;
+    measure(state, corpus.json.size(), [&]()
+    {
+        JsonStringViewBufferReader buffer(corpus.json);
+        return handler.parse(buffer, operation(corpus));
+    });
+    benchmark::DoNotOptimize(handler.events);
+}
+
+static void saxParser(benchmark::State & state, const Corpus & corpus)
+{
+    JsonSAXParser parser;
+    NullCounter handler;
+    measure(state, corpus.json.size(), [&]()
+    {
+        JsonStringViewBufferReader buffer(corpus.json);
+        return parser.parse(handler, buffer, operation(corpus));
+    });
+    benchmark::DoNotOptimize(handler.events);
+}
+
+static void reader(benchmark::State & state, const Corpus & corpus)
+{
+    JsonReader reader;
+    measure(state, corpus.json.size(), [&]()
+    {
+        return reader.parse(corpus.json, [](JsonValue & value)
+        {
+            benchmark::DoNotOptimize(value);
+            return true;
+        }, operation(corpus));
+    });
+}
+
+static void fileReader(benchmark::State & state, const Corpus & corpus)
+{
+    JsonReader reader;
+    measure(state, corpus.json.size(), [&]()
+    {
+        return reader.parseFromFile(corpus.file, [](JsonValue & value)
+        {
+            benchmark::DoNotOptimize(value);
+            return true;
+        }, operation(corpus));
+    });
+}
+
+//NDJSON input is written as an array of its records
+static JsonValue tree(const Corpus & corpus)
+{
+    if(!corpus.multiple) return JsonReader().parse(corpus.json);
+
+    JsonValue::Array records;
+    JsonReader().parse(corpus.json, [&records](JsonValue & value)
+    {
+        records.append(value);
+        return true;
+    }, JsonSAXReader::Multiple);
+    return records;
+}
+
+static void writer(benchmark::State & state, const Corpus & corpus)
+{
+    const JsonValue json = tree(corpus);
+    JsonWriter writer;
+    std::string out;
+    writer.write(out, json);
+
+    measure(state, out.size(), [&]()
+    {
+        out.clear();
+        return writer.write(out, json);
+    });
+}
+
+//RFC 8785 text: sorted keys, ECMAScript numbers, validated UTF-8
+static void canonicalWriter(benchmark::State & state, const Corpus & corpus)
+{
+    const JsonValue json = tree(corpus);
+    JsonWriter writer;
+    std::string out;
+    writer.write(out, json, JsonFormat::Canonical);
+
+    measure(state, out.size(), [&]()
+    {
+        out.clear();
+        return writer.write(out, json, JsonFormat::Canonical);
+    });
+}
+
+static void fileWriter(benchmark::State & state, const Corpus & corpus)
+{
+    const JsonValue json = tree(corpus);
+    const std::string file = corpus.file + ".out";
+    JsonWriter writer;
+    const std::size_t size = writer.write(json).size();
+
+    measure(state, size, [&]()
+    {
+        return writer.writeToFile(file, json);
+    });
+
+    std::filesystem::remove(file);
+}
+
+//structural hash of a tree and deep equality with its clone, nothing is memoized
+static void hashTree(benchmark::State & state, const Corpus & corpus)
+{
+    const JsonValue json = tree(corpus);
+    measure(state, corpus.json.size(), [&]()
+    {
+        benchmark::DoNotOptimize(json.hash());
+        return true;
+    });
+}
+
+static void equalTree(benchmark::State & state, const Corpus & corpus)
+{
+    const JsonValue json = tree(corpus);
+    const JsonValue copy = json.clone();
+    measure(state, corpus.json.size(), [&]()
+    {
+        return json == copy;
+    });
+}
+
+//diff of a tree and its snapshot with the first leaf changed, the other subtrees stay shared
+static void patchDiff(benchmark::State & state, const Corpus & corpus)
+{
+    const JsonValue source = tree(corpus);
+    JsonValue target = source.snapshot();
+    JsonValue * leaf = &target;
+
+    for(;;)
+    {
+        const JsonValue::Value & value = leaf->getValue();
+        const JsonValue::Object * object = std::get_if<JsonValue::Object>(&value);
+        const JsonValue::Array * array = std::get_if<JsonValue::Array>(&value);
+
+        if(object != nullptr && object->count() > 0) leaf = &leaf->edit(std::string(object->getMap().begin()->first));
+        else if(array != nullptr && array->count() > 0) leaf = &leaf->edit(std::size_t(0));
+        else break;
+    }
+
+    *leaf = "changed";
+
+    measure(state, corpus.json.size(), [&]()
+    {
+        return JsonPatch::diff(source, target).getArray().count() == 1;
+    });
+}
+
+int main(int argc, char ** argv)
+{
+    for(const Corpus & corpus : corpora())
+    {
+        benchmark::RegisterBenchmark(("JsonSAXReader/" + corpus.name).c_str(), saxReader, corpus);
+        benchmark::RegisterBenchmark(("JsonSAXParser/" + corpus.name).c_str(), saxParser, corpus);
+        benchmark::RegisterBenchmark(("JsonReader/" + corpus.name).c_str(), reader, corpus);
+        benchmark::RegisterBenchmark(("JsonFileBufferReader/" + corpus.name).c_str(), fileReader, corpus);
+        benchmark::RegisterBenchmark(("JsonWriter/" + corpus.name).c_str(), writer, corpus);
+        benchmark::RegisterBenchmark(("JsonFileBufferWriter/" + corpus.name).c_str(), fileWriter, corpus);
+        benchmark::RegisterBenchmark(("JsonWriter/Canonical/" + corpus.name).c_str(), canonicalWriter, corpus);
+        benchmark::RegisterBenchmark(("JsonPatch::diff/" + corpus.name).c_str(), patchDiff, corpus);
+        benchmark::RegisterBenchmark(("JsonValue::hash/" + corpus.name).c_str(), hashTree, corpus);
+        benchmark::RegisterBenchmark(("JsonValue::operator==/" + corpus.name).c_str(), equalTree, corpus);
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    for(const Corpus & corpus : corpora()) std::filesystem::remove(corpus.file);
+    return 0;
+}
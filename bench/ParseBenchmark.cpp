@@ -0,0 +1,57 @@
+#include "BenchSupport.h"
+#include <chrono>
+#include <iostream>
+
+//Parse throughput check without the benchmark library:
+//g++ -std=c++20 -O2 Json.cpp bench/BenchSupport.cpp bench/ParseBenchmark.cpp -o parse_benchmark
+
+static std::string makeDocument(std::size_t records)
+{
+    std::string json = "[";
+
+    for(std::size_t i = 0; i < records; i++)
+    {
+        if(i > 0) json += ",\n";
+        json += "{\"id\": " + std::to_string(i * 7919) +
+                ", \"name\": \"user_" + std::to_string(i) + "\\tname\"" +
+                ", \"score\": " + std::to_string(i % 100) + ".25" +
+                ", \"active\": " + ((i % 2) ? "true" : "false") +
+                ", \"parent\": null, \"tags\": [\"a\", \"bb\", \"ccc\"], \"pos\": {\"x\": -12, \"y\": 3.5}}";
+    }
+
+    return json + "]";
+}
+
+template<typename Function>
+static void run(const char * name, const std::string & json, std::size_t iterations, Function function)
+{
+    function(); //warm up
+
+    const auto begin = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < iterations; i++) function();
+    const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+
+    const double mb = static_cast<double>(json.size()) * iterations / (1024.0 * 1024.0);
+    std::cout << name << ": " << mb / seconds.count() << " MB/s" << std::endl;
+}
+
+int main()
+{
+    const std::string json = makeDocument(20000);
+    const std::size_t iterations = 20;
+
+    NullHandler handler;
+    run("JsonSAXReader", json, iterations, [&]()
+    {
+        JsonStringViewBufferReader buffer(json);
+        if(!handler.parse(buffer, JsonSAXReader::Single)) std::cerr << handler.error() << std::endl;
+    });
+
+    JsonReader reader;
+    run("JsonReader", json, iterations, [&]()
+    {
+        if(reader.parse(json).isEmpty()) std::cerr << reader.error() << std::endl;
+    });
+
+    return 0;
+}
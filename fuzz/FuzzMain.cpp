@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Driver of the harnesses for compilers without libFuzzer (g++): runs the files and the files of
+//directories given on the command line, -runs=N adds N inputs mutated from them, -seed=N.
+//Other options starting with '-' are ignored, a command line of a libFuzzer binary works as is.
+//An input that aborts is saved to crash-input (sanitizers abort with ASAN_OPTIONS=abort_on_error=1).
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t * data, std::size_t size);
+
+static const std::string * current = nullptr;
+
+static void saveCrash(int signal)
+{
+    if(current != nullptr)
+    {
+       if(std::FILE * file = std::fopen("crash-input", "wb"))
+       {
+          std::fwrite(current->data(), 1, current->size(), file);
+          std::fclose(file);
+       }
+
+       std::fprintf(stderr, "Input of %zu bytes saved to crash-input\n", current->size());
+    }
+
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+static void run(const std::string & input)
+{
+    current = &input;
+    LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t *>(input.data()), input.size());
+    current = nullptr;
+}
+
+static bool readFile(const std::filesystem::path & path, std::vector<std::string> & inputs)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if(!stream.is_open()) return false;
+
+    std::ostringstream data;
+    data << stream.rdbuf();
+    inputs.push_back(data.str());
+    return true;
+}
+
+static std::string mutate(std::string input, const std::vector<std::string> & inputs, std::mt19937_64 & random)
+{
+    static const char * const tokens[] = {"{", "}", "[", "]", "\"", ":", ",", "0", "-1", "1.5", "e+9", "true", "false", "null",
+                                          "\\\"", "\\u00e9", "\\ud83d\\ude00", "\xc3\xa9", " ", "\n", "{\"a\":[", "]}",
+                                          "//", "/*", "*/", "'", "0x", "+", ".", "Infinity", "NaN", "{a:",
+                                          "{\"op\":\"add\",\"path\":\"/", "\"from\":\"/", "/0", "/-", "~1"};
+    const std::size_t count = 1 + random() % 4;
+
+    for(std::size_t i = 0; i < count; i++)
+    {
+        const std::size_t pos = input.empty() ? 0 : random() % (input.size() + 1);
+
+        switch(random() % 6)
+        {
+           case 0: if(pos < input.size()) input[pos] = static_cast<char>(input[pos] ^ (1 << (random() % 8)));
+           break;
+           case 1: input.insert(pos, 1, static_cast<char>(random()));
+           break;
+           case 2: input.insert(pos, tokens[random() % std::size(tokens)]);
+           break;
+           case 3: if(pos < input.size()) input.erase(pos, 1 + random() % std::min<std::size_t>(8, input.size() - pos));
+           break;
+           case 4:
+           {
+              if(pos >= input.size()) break;
+              const std::size_t length = 1 + random() % std::min<std::size_t>(64, input.size() - pos);
+              input.insert(random() % (input.size() + 1), input.substr(pos, length));
+           }
+           break;
+           default:
+           {
+              const std::string & other = inputs[random() % inputs.size()];
+              if(other.empty()) break;
+              const std::size_t first = random() % other.size();
+              input.insert(pos, other, first, 1 + random() % std::min<std::size_t>(64, other.size() - first));
+           }
+        }
+    }
+
+    return input;
+}
+
+int main(int argc, char ** argv)
+{
+    std::signal(SIGABRT, saveCrash);
+    std::signal(SIGSEGV, saveCrash);
+
+    std::vector<std::string> inputs;
+    std::size_t runs = 0;
+    std::uint64_t seed = 1;
+
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+
+        if(arg.starts_with("-runs=")) runs = std::strtoull(argv[i] + 6, nullptr, 10);
+        else if(arg.starts_with("-seed=")) seed = std::strtoull(argv[i] + 6, nullptr, 10);
+        else if(arg.starts_with("-")) continue;
+        else if(std::filesystem::is_directory(arg))
+        {
+           std::vector<std::filesystem::path> files;
+           for(const auto & entry : std::filesystem::directory_iterator(arg)) if(entry.is_regular_file()) files.push_back(entry.path());
+           std::sort(files.begin(), files.end());
+           for(const auto & file : files) readFile(file, inputs);
+        }
+        else if(!readFile(std::filesystem::path(arg), inputs))
+        {
+           std::fprintf(stderr, "Cannot read %s\n", argv[i]);
+           return 1;
+        }
+    }
+
+    for(const std::string & input : inputs) run(input);
+    const std::size_t replayed = inputs.size();
+    if(inputs.empty()) inputs.emplace_back();
+
+    std::mt19937_64 random(seed);
+    for(std::size_t i = 0; i < runs; i++) run(mutate(inputs[random() % inputs.size()], inputs, random));
+
+    std::printf("Done %zu inputs\n", replayed + runs);
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "JsonFuzz.h"
+
+//JsonPatch and JsonWriter::writeMerged on a stream of documents: the first one is the base, each
+//next array is applied to it as a JSON Patch and each next object as a Merge Patch. A JSON Patch
+//must give the same result as its operations applied one by one without the cached path, an atomic
+//patch that fails must leave the document as it was. writeMerged must write the tree JsonPatch::merge
+//builds, also as canonical text. Snapshots taken before a patch must keep their text, the diff of a snapshot and the
+//patched document must turn the snapshot into the document, as the diff of the document and the
+//next value read must turn the document into that value. Hashes memoized before a patch must not
+//survive its edits.
+
+//A patch can replace the whole document with a scalar, it is written as the item of an array
+static std::string compact(const JsonValue & value)
+{
+    JsonValue wrapper(JsonValue::Array{});
+    wrapper.editArray().append(value);
+
+    std::string text;
+    FUZZ_CHECK(JsonWriter().write(text, wrapper), "tree is not written");
+    return text;
+}
+
+static void applyPatch(JsonValue & document, const JsonValue & patch, bool atomic)
+{
+    const std::string before = compact(document);
+
+    JsonValue expected = document.clone();
+    bool accepted = true;
+
+    for(const JsonValue & operation : patch.getArray().getVector())
+    {
+        JsonValue single(JsonValue::Array{});
+        single.editArray().append(operation);
+        if(!(accepted = JsonPatch().apply(expected, single))) break;
+    }
+
+    JsonPatch applier;
+    applier.setAtomic(atomic);
+    const bool ret = applier.apply(document, patch);
+
+    FUZZ_CHECK(ret == accepted, "patch result differs from its operations applied one by one");
+    FUZZ_CHECK(ret || !applier.error().empty(), "patch rejected without an error");
+    if(ret || !atomic) FUZZ_CHECK(compact(document) == compact(expected), "patched document differs from its operations applied one by one");
+    else FUZZ_CHECK(compact(document) == before, "failed atomic patch changed the document");
+}
+
+static void applyMerge(JsonValue & document, const JsonValue & patch, bool binary)
+{
+    if(patch.type() != JsonType::Object) return;
+
+    JsonWriter writer;
+    std::string merged;
+    FUZZ_CHECK(writer.writeMerged(merged, document, patch), "merged tree is not written");
+
+    //definite sizes of the merged containers are counted before they are written
+    if(binary)
+    {
+       for(JsonFormat format : {JsonFormat::MessagePack, JsonFormat::CBOR})
+       {
+           JsonStringBufferWriter output;
+           FUZZ_CHECK(writer.writeMerged(output, document, patch, format), "merged tree is not written in a binary format");
+           JsonReader reader;
+           FUZZ_CHECK(JsonWriter().write(reader.parse(output.result(), format)) == merged, "binary merged output is read back as another document");
+       }
+    }
+
+    //canonical keys of the base and of the patch are sorted together
+    JsonStringBufferWriter canonical;
+    const bool written = writer.writeMerged(canonical, document, patch, JsonFormat::Canonical);
+
+    JsonPatch::merge(document, patch);
+    FUZZ_CHECK(merged == JsonWriter().write(document), "writeMerged differs from the merged tree");
+
+    std::string expected;
+    FUZZ_CHECK(written == JsonWriter().write(expected, document, JsonFormat::Canonical), "canonical writeMerged fails differently from the merged tree");
+    FUZZ_CHECK(!written || canonical.result() == expected, "canonical writeMerged differs from the merged tree");
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t * data, std::size_t size)
+{
+    std::string_view input(reinterpret_cast<const char *>(data), size);
+    const bool atomic = (size % 2 == 0);
+
+    JsonValue document;
+    JsonReader reader;
+
+    reader.parse(input, [&](JsonValue & value)
+    {
+        if(document.isEmpty())
+        {
+           document = value;
+           return true;
+        }
+
+        JsonValue other = document.clone();
+        FUZZ_CHECK(JsonPatch().apply(other, JsonPatch::diff(document, value)), "diff of unrelated trees is not applied");
+        FUZZ_CHECK(compact(other) == compact(value), "diff does not turn one tree into the other");
+
+        //the edits of the patches must drop the memoized hashes on their way
+        document.hash(true);
+        const JsonValue snapshot = document.snapshot();
+        const std::string before = compact(snapshot);
+
+        if(value.type() == JsonType::Array) applyPatch(document, value, atomic);
+        else applyMerge(document, value, !atomic);
+
+        FUZZ_CHECK(compact(snapshot) == before, "snapshot changed by a patch");
+
+        JsonValue rebuilt = snapshot.clone();
+        FUZZ_CHECK(JsonPatch().apply(rebuilt, JsonPatch::diff(snapshot, document)), "diff is not applied");
+        FUZZ_CHECK(compact(rebuilt) == compact(document), "diff does not rebuild the document");
+        FUZZ_CHECK(rebuilt == document && rebuilt.hash() == document.hash(), "rebuilt document is not equal");
+        FUZZ_CHECK(document.hash() == document.clone().hash(), "memoized hash is stale after a patch");
+        FUZZ_CHECK(JsonPatch::diff(document.clone(), document).getArray().count() == 0, "diff of equal trees is not empty");
+        return true;
+    }, JsonReader::Multiple);
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include "JsonFuzz.h"
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+
+//JsonReader and JsonWriter round trips. A first byte below 0x08 configures the run (the text
+//reader rejects it as a control character): bits 0-1 - input format (0 and 3 text, 1 MessagePack,
+//2 CBOR), bit 2 - raw keys, parent links, index keys and a monotonic arena for the trees, the
+//input is read again into a 4 KiB arena without upstream.
+//Every document read is written as compact and pretty text, MessagePack, CBOR and through the
+//writer cache (binary formats and canonical text bypass it), each output read back must be written
+//as the same compact text. A deep copy must be equal to the document and have its hash, memoized
+//or not, also after an edit through the handle of a nested container. Canonical text read back
+//must be written as the same canonical text. The document put into itself must be sized as written.
+
+static const std::unordered_set<std::string> rawKeys = {"raw", "r"};
+static const JsonValue::Array::Path indexPath = {"id"};
+
+static std::string compact(const JsonValue & value)
+{
+    std::string text;
+    FUZZ_CHECK(JsonWriter().write(text, value), "tree is not written");
+    return text;
+}
+
+static std::string reread(const std::string & data, JsonFormat format = JsonFormat::Text)
+{
+    JsonReader reader;
+    const JsonValue value = reader.parse(data, format);
+    FUZZ_CHECK(!value.isEmpty(), "writer output is not read back");
+    return compact(value);
+}
+
+static void checkLinks(const JsonValue & document)
+{
+    document.search([](const JsonValue & value, const std::string &, std::size_t depth)
+    {
+        const bool container = (value.type() == JsonType::Object || value.type() == JsonType::Array);
+        FUZZ_CHECK(depth == 0 || !container || !value.parent().isEmpty(), "container without a parent link");
+        return true;
+    });
+}
+
+static void checkIndexes(const JsonValue & document)
+{
+    for(const JsonValue & value : document.find("items"))
+    {
+        if(value.type() != JsonType::Array) continue;
+
+        const JsonValue::Array array = value.getArray();
+        const JsonValue::Array::Vector & items = array.getVector();
+        const JsonValue::Array scanned = value.clone().getArray(); //no index, lookups scan the items
+
+        for(std::size_t i = 0; i < items.size(); i++)
+        {
+            if(items[i].type() != JsonType::Object) continue;
+            const JsonValue key = items[i].getObject().value("id");
+            if(key.type() == JsonType::Empty || key.type() == JsonType::Object || key.type() == JsonType::Array || key.type() == JsonType::Raw) continue;
+            if(key.type() == JsonType::Double && std::isnan(key.getDouble())) continue; //equal to no key
+
+            const std::vector<std::size_t> positions = array.lookupAll(indexPath, key);
+            FUZZ_CHECK(std::find(positions.begin(), positions.end(), i) != positions.end(), "indexed item is not found");
+            FUZZ_CHECK(scanned.lookupAll(indexPath, key) == positions, "scan finds other items than the index");
+        }
+    }
+}
+
+//A container holding itself is written with null in its place, size() must count the same
+static void checkCycle(const JsonValue & document)
+{
+    JsonValue cyclic = document.clone();
+    JsonWriter writer;
+    std::string text, pretty;
+
+    if(cyclic.type() == JsonType::Object) cyclic.getObject().insert("self", cyclic);
+    else cyclic.getArray().append(cyclic);
+
+    FUZZ_CHECK(writer.write(text, cyclic) && writer.write(pretty, cyclic, true), "cyclic tree is not written");
+    FUZZ_CHECK(writer.size(cyclic) == text.size(), "size() differs from the output of a cyclic tree");
+    FUZZ_CHECK(writer.size(cyclic, true) == pretty.size(), "size(beautiful) differs from the output of a cyclic tree");
+
+    //break the cycle, the tree is not freed otherwise
+    if(cyclic.type() == JsonType::Object) cyclic.getObject().clear();
+    else cyclic.getArray().clear();
+}
+
+//Changes the first container below the top one through its own handle, false - there is none
+static bool editNested(const JsonValue & document)
+{
+    JsonValue nested;
+
+    document.search([&nested](const JsonValue & value, const std::string &, std::size_t depth)
+    {
+        if(depth > 0 && (value.type() == JsonType::Object || value.type() == JsonType::Array)) nested = value;
+        return nested.isEmpty();
+    });
+
+    if(nested.isEmpty()) return false;
+    if(nested.type() == JsonType::Object) nested.getObject()["edited"] = true;
+    else nested.getArray().append(true);
+    return true;
+}
+
+//The memoized hashes of the ancestors of the changed container must be dropped
+static void checkNestedEdit(const JsonValue & document)
+{
+    const JsonValue memoized = document.clone();
+    const JsonValue expected = document.clone();
+    memoized.hash(true);
+    if(!editNested(memoized)) return;
+
+    editNested(expected);
+    expected.hash(true);
+    FUZZ_CHECK(memoized.hash() == expected.hash() && memoized == expected, "memoized hash is stale after an edit through a nested handle");
+    FUZZ_CHECK(memoized.hash(true) == expected.hash(), "hash memoized again differs after an edit through a nested handle");
+}
+
+static void checkDocument(const JsonValue & document, bool raw)
+{
+    JsonWriter writer;
+    const std::string text = compact(document);
+    FUZZ_CHECK(writer.size(document) == text.size(), "size() differs from the output");
+
+    //Raw values keep their input text, the first round trip normalizes them
+    const std::string expected = reread(text);
+    FUZZ_CHECK(raw || expected == text, "compact output changes after a round trip");
+    FUZZ_CHECK(reread(expected) == expected, "round trip is not a fixed point");
+
+    std::string pretty;
+    FUZZ_CHECK(writer.write(pretty, document, true), "tree is not written pretty");
+    FUZZ_CHECK(writer.size(document, true) == pretty.size(), "size(beautiful) differs from the output");
+    FUZZ_CHECK(reread(pretty) == expected, "pretty output is read back as another document");
+
+    JsonWriter cached;
+    cached.setCache(true);
+    FUZZ_CHECK(cached.write(document) == text, "cached writer output differs");
+    FUZZ_CHECK(cached.write(document) == text, "output from the cache differs");
+
+    FUZZ_CHECK(compact(document.clone()) == text, "clone is written differently");
+    checkCycle(document);
+
+    const JsonValue copy = document.clone();
+    FUZZ_CHECK(copy == document && copy.hash() == document.hash(), "clone is not equal to the document");
+    FUZZ_CHECK(copy.hash(true) == document.hash() && copy.hash() == document.hash(), "memoized hash differs");
+    checkNestedEdit(document);
+
+    //Raw values, NaN, infinities and invalid UTF-8 have no canonical text
+    std::string canonical;
+
+    if(writer.write(canonical, document, JsonFormat::Canonical))
+    {
+       JsonReader reader;
+       const JsonValue value = reader.parse(canonical, JsonFormat::Text);
+       FUZZ_CHECK(!value.isEmpty(), "canonical output is not read back");
+       FUZZ_CHECK(JsonWriter().write(value, JsonFormat::Canonical) == canonical, "canonical output is not a fixed point");
+       FUZZ_CHECK(cached.write(document, JsonFormat::Canonical) == canonical, "cached writer canonical output differs");
+    }
+    else FUZZ_CHECK(!writer.error().empty(), "canonical output rejected without an error");
+
+    //Binary formats have no raw values
+    if(raw) return;
+
+    for(JsonFormat format : {JsonFormat::MessagePack, JsonFormat::CBOR})
+    {
+        std::string binary;
+        FUZZ_CHECK(writer.write(binary, document, format), "tree is not written in a binary format");
+        FUZZ_CHECK(reread(binary, format) == text, "binary output is read back as another document");
+        FUZZ_CHECK(cached.write(document, format) == binary, "cached writer binary output differs");
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t * data, std::size_t size)
+{
+    std::string_view input(reinterpret_cast<const char *>(data), size);
+    JsonFormat format = JsonFormat::Text;
+    bool options = false;
+
+    if(!input.empty() && static_cast<unsigned char>(input[0]) < 0x08)
+    {
+       const unsigned char config = input[0];
+       input.remove_prefix(1);
+
+       if((config & 3) == 1) format = JsonFormat::MessagePack;
+       else if((config & 3) == 2) format = JsonFormat::CBOR;
+       options = (config & 4) != 0;
+    }
+
+    const bool raw = options && format == JsonFormat::Text;
+    std::pmr::monotonic_buffer_resource arena;
+    JsonReader reader;
+
+    if(options)
+    {
+       if(raw) reader.setRawKeys(rawKeys);
+       reader.setParentLinks(true);
+       reader.setIndexKeys({{"items", indexPath}});
+       reader.setMemoryResource(&arena);
+    }
+
+    const bool accepted = reader.parse(input, [&](JsonValue & document)
+    {
+        checkDocument(document, raw);
+
+        if(options)
+        {
+           checkLinks(document);
+           checkIndexes(document);
+        }
+
+        return true;
+    }, JsonReader::Multiple, format);
+
+    FUZZ_CHECK(accepted || !reader.error().empty(), "rejected without an error");
+
+    //an exhausted arena fails the parse with an error, std::bad_alloc does not escape it
+    if(options)
+    {
+       alignas(std::max_align_t) char buffer[4096];
+       std::pmr::monotonic_buffer_resource bounded(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+       JsonReader limited;
+       if(raw) limited.setRawKeys(rawKeys);
+       limited.setParentLinks(true);
+       limited.setIndexKeys({{"items", indexPath}});
+       limited.setMemoryResource(&bounded);
+
+       const bool read = limited.parse(input, [](JsonValue &){ return true; }, JsonReader::Multiple, format);
+       FUZZ_CHECK(read ? accepted : !limited.error().empty(), "bounded arena changes the result");
+    }
+
+    return 0;
+}
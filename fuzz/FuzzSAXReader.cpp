@@ -0,0 +1,171 @@
+#include "JsonFuzz.h"
+#include <filesystem>
+#include <random>
+
+#if defined(JSON_FUZZ_JSONCPP)
+#include <json/json.h>
+#endif
+
+//Differential checks of JsonSAXReader on text input:
+// - JsonStringViewBufferReader and JsonFuzzBufferReader give the same events and the same error,
+//   a vectorized reader path, when added, is compared here the same way
+// - JsonSAXParser::parse with static dispatch gives the events of the virtual JsonSAXReader
+// - a document written again as MessagePack, CBOR and text is read back with the same events, it is
+//   accepted with a byte limit of its size, with a limit of about half of it no longer string is read,
+//   the limits are also checked on the document read from a file (JsonFileBufferReader counts from 1)
+// - JSON5 is a superset, input accepted as JSON is read as JSON5 with the same events
+// - JSON_FUZZ_JSONCPP: values of documents accepted by both parsers are equal
+
+//Input written to a file of this process and read through JsonFileBufferReader
+struct FuzzFile
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / ("FuzzSAXReader." + std::to_string(std::random_device()()));
+
+    ~FuzzFile(){ std::error_code error; std::filesystem::remove(path, error); }
+
+    bool read(JsonFuzzEvents & events, const std::string & input, JsonFormat format) const
+    {
+        {
+           std::ofstream file(path, std::ios::binary | std::ios::trunc);
+           file.write(input.data(), static_cast<std::streamsize>(input.size()));
+           FUZZ_CHECK(file.good(), "input is not written to a file");
+        }
+
+        JsonFileBufferReader buffer;
+        FUZZ_CHECK(buffer.open(path.string()), "input file is not opened");
+        return events.read(buffer, format);
+    }
+};
+
+#if defined(JSON_FUZZ_JSONCPP)
+static bool sameValue(const JsonValue & value, const Json::Value & reference)
+{
+    switch(value.type())
+    {
+       case JsonType::Object:
+       {
+          const JsonValue::Object object = value.getObject();
+          if(!reference.isObject() || reference.size() != object.count()) return false;
+
+          for(const auto & [key, item] : object.getMap())
+          {
+              const Json::Value * found = reference.find(key.data(), key.data() + key.size());
+              if(found == nullptr || !sameValue(item, *found)) return false;
+          }
+
+          return true;
+       }
+       case JsonType::Array:
+       {
+          const JsonValue::Array items = value.getArray();
+          const JsonValue::Array::Vector & array = items.getVector();
+          if(!reference.isArray() || reference.size() != array.size()) return false;
+
+          for(Json::ArrayIndex i = 0; i < array.size(); i++)
+          {
+              if(!sameValue(array[i], reference[i])) return false;
+          }
+
+          return true;
+       }
+       case JsonType::String:
+       {
+          const char * first = nullptr, * last = nullptr;
+          return reference.isString() && reference.getString(&first, &last) && std::string_view(first, last - first) == value.getString();
+       }
+       //Integers out of the long long range: JsonSAXReader reads a double, jsoncpp an unsigned integer
+       case JsonType::Double: return reference.isNumeric() && reference.asDouble() == value.getDouble();
+       case JsonType::LongLong: return reference.isInt64() && reference.asInt64() == value.getLongLong();
+       case JsonType::Bool: return reference.isBool() && reference.asBool() == value.getBool();
+       case JsonType::Null: return reference.isNull();
+       default: return false;
+    }
+}
+
+static void compareReference(std::string_view input)
+{
+    JsonValue value = JsonReader().parse(input);
+    if(value.isEmpty()) return;
+
+    Json::CharReaderBuilder builder;
+    Json::CharReaderBuilder::strictMode(&builder.settings_);
+    builder["stackLimit"] = 256;
+    const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+
+    Json::Value reference;
+    std::string error;
+
+    //Input accepted only by JsonSAXReader: leading zeros, data after the document
+    try { if(!reader->parse(input.data(), input.data() + input.size(), &reference, &error)) return; }
+    catch(const std::exception &) { return; }
+
+    FUZZ_CHECK(sameValue(value, reference), "JsonReader and jsoncpp values differ");
+}
+#endif
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t * data, std::size_t size)
+{
+    const std::string_view input(reinterpret_cast<const char *>(data), size);
+
+    for(JsonSAXReader::Operation operation : {JsonSAXReader::Single, JsonSAXReader::Multiple})
+    {
+        JsonFuzzEvents results[2];
+
+        for(JsonFormat format : {JsonFormat::Text, JsonFormat::JSON5})
+        {
+            JsonFuzzEvents & view = results[format == JsonFormat::JSON5];
+            JsonFuzzEvents bytes, statics;
+            JsonFuzzBufferReader buffer(input);
+
+            const bool accepted = view.read(input, format, operation);
+            FUZZ_CHECK(accepted == bytes.read(buffer, format, operation), "reader paths disagree on the result");
+            FUZZ_CHECK(view.events == bytes.events, "reader paths give different events");
+            FUZZ_CHECK(view.error() == bytes.error(), "reader paths give different errors");
+            FUZZ_CHECK(accepted == statics.readStatic(input, format, operation), "static dispatch disagrees on the result");
+            FUZZ_CHECK(view.events == statics.events && view.error() == statics.error(), "static dispatch gives different events");
+            FUZZ_CHECK(accepted || !view.error().empty(), "rejected without an error");
+            if(!accepted) view.events.clear();
+        }
+
+        if(!results[0].events.empty()) FUZZ_CHECK(results[1].events == results[0].events, "JSON accepted is read as JSON5 with different events");
+    }
+
+    for(JsonFormat format : {JsonFormat::MessagePack, JsonFormat::CBOR, JsonFormat::Text})
+    {
+        JsonStringBufferWriter output;
+        JsonSAXWriter writer;
+        writer.setBuffer(&output, format);
+
+        JsonFuzzEvents source, back;
+        source.integral = back.integral = (format == JsonFormat::Text);
+        source.setForward(&writer);
+
+        if(!source.read(input, JsonFormat::Text)) return 0;
+        FUZZ_CHECK(source.forwarded(), "writer rejected events of an accepted document");
+        FUZZ_CHECK(back.read(output.result(), format), "writer output is not read back");
+        FUZZ_CHECK(source.events == back.events, "writer output is read back with different events");
+
+        const std::string & encoded = output.result();
+        if(encoded.size() <= 2) continue;
+
+        JsonFuzzEvents whole, half;
+        whole.integral = back.integral;
+        const std::size_t limit = encoded.size() / 2 + 1;
+        whole.setLimits({.bytes = encoded.size()});
+        half.setLimits({.bytes = limit});
+        FUZZ_CHECK(whole.read(encoded, format), "document as long as the byte limit is rejected");
+        FUZZ_CHECK(!half.read(encoded, format), "document over the byte limit is accepted");
+        FUZZ_CHECK(half.longest < limit, "string over the byte limit is read");
+
+        static const FuzzFile file;
+        FUZZ_CHECK(file.read(whole, encoded, format) && whole.events == back.events, "document from a file as long as the byte limit is rejected");
+        FUZZ_CHECK(!file.read(half, encoded, format), "document from a file over the byte limit is accepted");
+        FUZZ_CHECK(half.longest < limit, "string from a file over the byte limit is read");
+    }
+
+#if defined(JSON_FUZZ_JSONCPP)
+    compareReference(input);
+#endif
+
+    return 0;
+}
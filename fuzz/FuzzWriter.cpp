@@ -0,0 +1,185 @@
+#include "JsonFuzz.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+//JsonSAXWriter driven by a sequence of calls decoded from the input, the first byte selects the
+//output: text, pretty text, MessagePack, CBOR or canonical text. A rejected call must set an error
+//and change nothing. Containers still open at the end of the input are closed, and the finished document
+//must be read back with the events of the accepted calls.
+
+class FuzzInput final
+{
+    std::string_view data;
+    std::size_t pos = 0;
+
+public:
+    explicit FuzzInput(std::string_view data) : data(data){}
+
+    bool empty() const { return pos >= data.size(); }
+    unsigned char byte(){ return empty() ? 0 : static_cast<unsigned char>(data[pos++]); }
+
+    std::uint64_t bits()
+    {
+        std::uint64_t value = 0;
+        for(int i = 0; i < 8; i++) value = (value << 8) | byte();
+        return value;
+    }
+
+    std::string string()
+    {
+        const std::size_t size = std::min<std::size_t>(byte() % 16, data.size() - std::min(pos, data.size()));
+        std::string value(data.substr(pos, size));
+        pos += size;
+        return value;
+    }
+};
+
+//Raw values are already serialized json
+static const char * const snippets[] = {"[1,2]", "{\"a\":null}", "\"s\\n\"", "0.5", "[ { } , [ ] ]", "true"};
+
+static std::string snippetEvents(const char * snippet, bool integral)
+{
+    JsonFuzzEvents events;
+    events.integral = integral;
+    FUZZ_CHECK(events.read("[" + std::string(snippet) + "]", JsonFormat::Text), "raw snippet is not valid json");
+    return events.events.substr(2, events.events.size() - 4); //without the enclosing "B[" and "]E"
+}
+
+//Canonical numbers are the shortest digits of a double, up to 1e21 without an exponent: integers
+//and doubles beyond 2^53 are read back as the integer these digits spell
+template<typename T>
+static std::string canonicalEvents(T value)
+{
+    JsonStringBufferWriter output;
+    JsonSAXWriter writer;
+    writer.setBuffer(&output, JsonFormat::Canonical);
+    FUZZ_CHECK(writer.ArrayBegin() && writer.Value(value) && writer.ArrayEnd(), "canonical number is not written");
+
+    JsonFuzzEvents events;
+    events.integral = true;
+    FUZZ_CHECK(events.read(output.result(), JsonFormat::Text), "canonical number is not read back");
+    FUZZ_CHECK(std::strtod(output.result().c_str() + 1, nullptr) == static_cast<double>(value), "canonical number is not its double");
+    return events.events.substr(2, events.events.size() - 4); //without the enclosing "B[" and "]E"
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t * data, std::size_t size)
+{
+    FuzzInput input(std::string_view(reinterpret_cast<const char *>(data), size));
+
+    const unsigned char config = input.byte() % 5;
+    const JsonFormat format = (config == 2) ? JsonFormat::MessagePack : (config == 3) ? JsonFormat::CBOR :
+                              (config == 4) ? JsonFormat::Canonical : JsonFormat::Text;
+    const bool canonical = (format == JsonFormat::Canonical);
+    const bool text = (format == JsonFormat::Text || canonical);
+
+    JsonStringBufferWriter output;
+    JsonSAXWriter writer;
+    if(format == JsonFormat::Text) writer.setBuffer(&output, config == 1);
+    else writer.setBuffer(&output, format);
+
+    JsonFuzzEvents expected;
+    expected.integral = text;
+    expected.JsonBegin();
+
+    std::size_t depth = 0;
+    bool finished = false;
+
+    while(!input.empty() && !finished)
+    {
+        const std::size_t written = output.result().size();
+        const unsigned char op = input.byte();
+        const unsigned char arg = input.byte();
+        const std::size_t declared = (arg % 4 == 3) ? JsonSAXWriter::UnknownSize : arg % 4;
+        bool accepted = false;
+
+        switch(op % 12)
+        {
+           case 0: if((accepted = writer.ObjectBegin(declared))) { expected.ObjectBegin(); depth++; }
+           break;
+           case 1:
+           {
+              const std::string key = input.string();
+              if((accepted = writer.ObjectKey(key))) expected.ObjectKey(key);
+           }
+           break;
+           case 2: if((accepted = writer.ObjectEnd())) { expected.ObjectEnd(); finished = (--depth == 0); }
+           break;
+           case 3: if((accepted = writer.ArrayBegin(declared, (arg & 0x80) != 0))) { expected.ArrayBegin(); depth++; }
+           break;
+           case 4: if((accepted = writer.ArrayEnd())) { expected.ArrayEnd(); finished = (--depth == 0); }
+           break;
+           case 5:
+           {
+              const std::string value = input.string();
+              if((accepted = writer.Value(value))) expected.Value(value);
+           }
+           break;
+           case 6:
+           {
+              const double value = std::bit_cast<double>(input.bits());
+              if((accepted = writer.Value(value)))
+              {
+                 //Text has no NaN and infinities, they are written as null, canonical text rejects them
+                 if(canonical) expected.events += canonicalEvents(value);
+                 else if(text && !std::isfinite(value)) expected.Null();
+                 else expected.Value(value);
+              }
+           }
+           break;
+           case 7:
+           {
+              const long long value = static_cast<long long>(input.bits());
+              const bool exact = (value >= -(1LL << 53) && value <= (1LL << 53));
+
+              if((accepted = writer.Value(value)))
+              {
+                 if(canonical && !exact) expected.events += canonicalEvents(value);
+                 else expected.Value(value);
+              }
+           }
+           break;
+           case 8: if((accepted = writer.Value((arg & 1) != 0))) expected.Value((arg & 1) != 0);
+           break;
+           case 9: if((accepted = writer.Null())) expected.Null();
+           break;
+           case 10:
+           {
+              const char * snippet = snippets[arg % std::size(snippets)];
+              if((accepted = writer.Raw(snippet))) expected.events += snippetEvents(snippet, text);
+           }
+           break;
+           default:
+           {
+              const double value = static_cast<signed char>(arg) / 4.0;
+              if((accepted = writer.Value(value))) expected.Value(value);
+           }
+        }
+
+        //A rejected call writes nothing and leaves the state as is, the sequence goes on
+        if(!accepted)
+        {
+           FUZZ_CHECK(!writer.error().empty(), "call rejected without an error");
+           FUZZ_CHECK(output.result().size() == written, "rejected call changed the output");
+        }
+    }
+
+    //Containers left open at the end of the input are closed
+    while(!finished && depth > 0)
+    {
+        const bool object = writer.ObjectEnd();
+        if(object) expected.ObjectEnd();
+        else if(writer.ArrayEnd()) expected.ArrayEnd();
+        else return 0;
+        finished = (--depth == 0);
+    }
+
+    if(!finished) return 0;
+    expected.JsonEnd();
+
+    JsonFuzzEvents back;
+    back.integral = text;
+    FUZZ_CHECK(back.read(output.result(), format), "finished document is not read back");
+    FUZZ_CHECK(back.events == expected.events, "document is read back with other events");
+    return 0;
+}
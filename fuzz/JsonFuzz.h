@@ -0,0 +1,119 @@
+#ifndef JSON_FUZZ_H
+#define JSON_FUZZ_H
+
+#include "../Json.h"
+#include "../JsonSAXParser.h"
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//Shared parts of the fuzz harnesses: a failed check prints the reason and aborts,
+//libFuzzer (or FuzzMain.cpp) keeps the input that caused it
+
+#define FUZZ_CHECK(condition, message) \
+    do { if(!(condition)) { std::fprintf(stderr, "%s:%d: %s (%s)\n", __FILE__, __LINE__, message, #condition); std::abort(); } } while(false)
+
+//Input byte by byte without JsonBufferReader::copy, the reader takes its generic path
+class JsonFuzzBufferReader final : public JsonBufferReader
+{
+    std::string_view data;
+    std::size_t pos = 0;
+    bool started = false;
+
+public:
+    explicit JsonFuzzBufferReader(std::string_view data) : data(data){}
+
+    bool next() override
+    {
+        if(started && pos < data.size()) pos++;
+        started = true;
+        return pos < data.size();
+    }
+
+    unsigned char value() override { return (pos < data.size()) ? data[pos] : 0; }
+    std::size_t offset() override { return pos; }
+};
+
+//Event stream of a parse as a byte string, compared between reader paths and formats.
+//Events can be forwarded to a writer to encode the same document in another format.
+class JsonFuzzEvents final : public JsonSAXReader
+{
+    JsonSAXWriter * forward = nullptr;
+    bool forwardFailed = false;
+
+    void add(char tag, std::string_view data = std::string_view())
+    {
+        events.push_back(tag);
+        const std::uint64_t size = data.size();
+        events.append(reinterpret_cast<const char *>(&size), sizeof(size));
+        events.append(data);
+    }
+
+    template<typename T>
+    void addBits(char tag, T value)
+    {
+        events.push_back(tag);
+        events.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void send(bool result){ if(!result) forwardFailed = true; }
+
+public:
+    std::string events;
+    bool integral = false; //doubles with an integer value are recorded as integers (text output drops ".0")
+    std::size_t longest = 0; //longest key or string value
+
+    void setForward(JsonSAXWriter * writer){ forward = writer; forwardFailed = false; }
+    bool forwarded() const { return !forwardFailed; }
+
+    bool read(JsonBufferReader & buffer, JsonFormat format, Operation operation = Single)
+    {
+        events.clear();
+        longest = 0;
+        return parse(buffer, operation, format);
+    }
+
+    bool read(std::string_view input, JsonFormat format, Operation operation = Single)
+    {
+        JsonStringViewBufferReader buffer(input);
+        return read(buffer, format, operation);
+    }
+
+    //Callbacks of the final class are called without virtual dispatch
+    bool readStatic(std::string_view input, JsonFormat format, Operation operation = Single)
+    {
+        JsonStringViewBufferReader buffer(input);
+        events.clear();
+        longest = 0;
+        return JsonSAXParser::parse(*this, buffer, operation, format);
+    }
+
+    void JsonBegin() override { events.push_back('B'); }
+    void JsonEnd() override { events.push_back('E'); }
+
+    void ObjectBegin() override { events.push_back('{'); if(forward) send(forward->ObjectBegin()); }
+    void ObjectKey(const std::string & key) override { add('k', key); longest = std::max(longest, key.size()); if(forward) send(forward->ObjectKey(key)); }
+    void ObjectEnd() override { events.push_back('}'); if(forward) send(forward->ObjectEnd()); }
+
+    void ArrayBegin() override { events.push_back('['); if(forward) send(forward->ArrayBegin()); }
+    void ArrayEnd() override { events.push_back(']'); if(forward) send(forward->ArrayEnd()); }
+
+    void Value(const std::string & value) override { add('s', value); longest = std::max(longest, value.size()); if(forward) send(forward->Value(value)); }
+
+    void Value(double value) override
+    {
+        if(integral && value >= -0x1p63 && value < 0x1p63 && value == static_cast<double>(static_cast<long long>(value)))
+           addBits('i', static_cast<long long>(value));
+        else
+           addBits('d', std::bit_cast<std::uint64_t>(value));
+
+        if(forward) send(forward->Value(value));
+    }
+
+    void Value(long long value) override { addBits('i', value); if(forward) send(forward->Value(value)); }
+    void Value(bool value) override { events.push_back(value ? 't' : 'f'); if(forward) send(forward->Value(value)); }
+    void Null() override { events.push_back('n'); if(forward) send(forward->Null()); }
+};
+
+#endif // JSON_FUZZ_H